@@ -4,6 +4,8 @@ set -e
 
 export TIME="$(date "+%y%m%d_%H%M%S")"
 export BENCHMARK_N_EVENTS=5000
+# particle gun sampling: random, halton or stratified
+export SAMPLING="random"
 EIC_DIR="/eic"
 
 # particles
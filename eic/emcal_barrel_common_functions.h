@@ -4,6 +4,10 @@
 //////////////////////////
 
 #include <cctype>
+#include <cstdlib>
+#include <iostream>
+#include <string>
+#include <tuple>
 #include "TH1.h"
 
 // Returns particle pdgID and mass in [GeV]
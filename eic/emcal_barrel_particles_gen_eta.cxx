@@ -12,6 +12,7 @@
 #include "TMath.h"
 #include "TRandom.h"
 
+#include <algorithm>
 #include <cmath>
 #include <iostream>
 #include <math.h>
@@ -27,6 +28,83 @@ double eta_to_theta(double eta)
   return 2 * std::atan(std::exp(-eta));
 }
 
+// radical inverse of index in the given base, a point of the Halton sequence.
+double radical_inverse(unsigned long index, unsigned base)
+{
+  double inverse = 0.0;
+  double scale = 1.0 / base;
+  for (; index > 0; index /= base, scale /= base) {
+    inverse += (index % base) * scale;
+  }
+  return inverse;
+}
+
+/*
+ * unit cube points (p, phi, cos(theta)) of the particle gun.
+ *   random     - independent uniforms, the original behaviour.
+ *   halton     - Halton sequence in bases 2, 3, 5 with a random shift modulo 1
+ *                (Cranley-Patterson), so estimates stay unbiased. job `offset`
+ *                starts at index offset * n_events and seeds the shift, so
+ *                jobs use disjoint parts of the sequence.
+ *   stratified - phi x cos(theta) grid of about n_events cells, one jittered
+ *                point per cell, visited from stratum `offset` on; p random.
+ *                events left after the last full pass are random.
+ * the low discrepancy modes cover phi and cos(theta) evenly with few events,
+ * removing the part of the cell's spread that comes from where the particle
+ * hits (eta slope, module and fiber structure). shower fluctuations are not
+ * affected.
+ */
+class GunSampler
+{
+public:
+  GunSampler(const std::string& mode, int n_events, int offset, TRandom* random)
+    : m_mode(mode), m_nEvents(n_events), m_offset(offset), m_random(random)
+  {
+    if (m_mode != "random" && m_mode != "halton" && m_mode != "stratified") {
+      std::cout << "wrong sampling name" << std::endl;
+      abort();
+    }
+    TRandom shift_random(4357 + offset);
+    for (int i = 0; i < 3; ++i) {
+      m_shift[i] = shift_random.Rndm();
+    }
+    m_nStrata = std::max(1, int(std::sqrt(double(n_events))));
+    // events beyond the last complete pass over the grid are plain random,
+    // a partial pass would weight some strata twice.
+    m_nStratified = n_events / (m_nStrata * m_nStrata) * m_nStrata * m_nStrata;
+  }
+
+  void next(int event, double* u)
+  {
+    if (m_mode == "halton") {
+      const unsigned bases[3] = {2, 3, 5};
+      unsigned long index = (unsigned long)m_offset * m_nEvents + event + 1;
+      for (int i = 0; i < 3; ++i) {
+        u[i] = radical_inverse(index, bases[i]) + m_shift[i];
+        u[i] -= std::floor(u[i]);
+      }
+    } else if (m_mode == "stratified" && event < m_nStratified) {
+      int stratum = (event + m_offset) % (m_nStrata * m_nStrata);
+      u[0] = m_random->Rndm();
+      u[1] = (stratum % m_nStrata + m_random->Rndm()) / m_nStrata;
+      u[2] = (stratum / m_nStrata + m_random->Rndm()) / m_nStrata;
+    } else {
+      for (int i = 0; i < 3; ++i) {
+        u[i] = m_random->Rndm();
+      }
+    }
+  }
+
+private:
+  std::string m_mode;
+  int m_nEvents;
+  int m_offset;
+  TRandom* m_random;
+  double m_shift[3];
+  int m_nStrata;
+  int m_nStratified;
+};
+
 void 
 emcal_barrel_particles_gen_eta
 (
@@ -35,7 +113,9 @@ emcal_barrel_particles_gen_eta
     double e_end = 20.0,
     double eta_start = -1.7,
     double eta_end = 1.3,
-    std::string particle_name = "electron"
+    std::string particle_name = "electron",
+    std::string sampling = "random",
+    int offset = 0
 ) {
   std::string out_fname = fmt::format("{}", std::getenv("JUGGLER_GEN_FILE"));
   WriterAscii hepmc_output(out_fname);
@@ -44,6 +124,7 @@ emcal_barrel_particles_gen_eta
 
   // Random number generator
   TRandom* r1 = new TRandom();
+  GunSampler sampler(sampling, n_events, offset, r1);
 
   // Constraining the solid angle, but larger than that subtended by the
   // detector
@@ -63,9 +144,11 @@ emcal_barrel_particles_gen_eta
     GenParticlePtr p2 = std::make_shared<GenParticle>(FourVector(0.0, 0.0, 0.0, 0.938), 2212, 4);
 
     // Define momentum
-    Double_t p        = r1->Uniform(e_start, e_end);
-    Double_t phi      = r1->Uniform(0.0, 2.0 * M_PI);
-    Double_t costheta = r1->Uniform(cos_theta_min, cos_theta_max);
+    double u[3];
+    sampler.next(events_parsed, u);
+    Double_t p        = e_start + (e_end - e_start) * u[0];
+    Double_t phi      = 2.0 * M_PI * u[1];
+    Double_t costheta = cos_theta_min + (cos_theta_max - cos_theta_min) * u[2];
     Double_t theta    = std::acos(costheta);
     Double_t px       = p * std::cos(phi) * std::sin(theta);
     Double_t py       = p * std::sin(phi) * std::sin(theta);
@@ -96,3 +179,36 @@ emcal_barrel_particles_gen_eta
   std::cout << "Events parsed and written: " << events_parsed << std::endl;
 }
 
+// standalone executable built by the Makefile; ROOT macro otherwise.
+// arguments are those of the macro, in the same order.
+#ifndef __CLING__
+int
+main(int argc, char** argv)
+{
+  if (argc > 9) {
+    std::cerr << fmt::format(
+      "usage: {} [N_EVENTS [E_START [E_END [ETA_START [ETA_END [PARTICLE "
+      "[random|halton|stratified [OFFSET]]]]]]]]\n",
+      argv[0]);
+    return 1;
+  }
+  try {
+    int n_events = argc > 1 ? std::stoi(argv[1]) : 1e6;
+    double e_start = argc > 2 ? std::stod(argv[2]) : 0.0;
+    double e_end = argc > 3 ? std::stod(argv[3]) : 20.0;
+    double eta_start = argc > 4 ? std::stod(argv[4]) : -1.7;
+    double eta_end = argc > 5 ? std::stod(argv[5]) : 1.3;
+    std::string particle_name = argc > 6 ? argv[6] : "electron";
+    std::string sampling = argc > 7 ? argv[7] : "random";
+    int offset = argc > 8 ? std::stoi(argv[8]) : 0;
+
+    emcal_barrel_particles_gen_eta(
+      n_events, e_start, e_end, eta_start, eta_end, particle_name, sampling,
+      offset);
+  } catch (const std::exception&) {
+    std::cerr << "invalid arguments\n";
+    return 1;
+  }
+  return 0;
+}
+#endif
@@ -151,3 +151,16 @@ void emcal_barrel_particles_reader_parallel(std::string particle_name = "electro
   */
 }
 
+// standalone executable built by the Makefile; ROOT macro otherwise.
+#ifndef __CLING__
+int
+main(int argc, char** argv)
+{
+  if (argc > 2) {
+    std::cerr << fmt::format("usage: {} [PARTICLE]\n", argv[0]);
+    return 1;
+  }
+  emcal_barrel_particles_reader_parallel(argc > 1 ? argv[1] : "electron");
+  return 0;
+}
+#endif
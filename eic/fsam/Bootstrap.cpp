@@ -0,0 +1,213 @@
+// C++
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// ROOT
+#include "TAxis.h"
+#include "TDirectory.h"
+#include "TF1.h"
+#include "TH1D.h"
+
+#include "Bootstrap.hpp"
+#include "ConcurrentFit.hpp"
+
+const size_t Bootstrap::s_replicasPerTask = 8;
+
+namespace
+{
+
+// cumulative Poisson(1) probabilities. P(k > 12) is below 1e-10.
+const size_t nPoissonThresholds = 12;
+
+struct PoissonTable
+{
+  double cdf[nPoissonThresholds];
+
+  PoissonTable()
+  {
+    double term = std::exp(-1.);
+    double sum = term;
+    for (size_t k = 0; k < nPoissonThresholds; ++k) {
+      cdf[k] = sum;
+      term /= k + 1;
+      sum += term;
+    }
+  }
+};
+
+const PoissonTable poissonTable;
+
+// counter based generator: the i-th uniform of a replica depends only on
+// (seed, i), so the weight loop has no carried state and vectorizes.
+inline std::uint64_t
+splitmix64(std::uint64_t x)
+{
+  x += 0x9e3779b97f4a7c15ULL;
+  x = (x ^ (x >> 30)) * 0xbf58476d1ce4e5b9ULL;
+  x = (x ^ (x >> 27)) * 0x94d049bb133111ebULL;
+  return x ^ (x >> 31);
+}
+
+double
+gausFunction(double* x, double* p)
+{
+  double t = (x[0] - p[1]) / p[2];
+  return p[0] * std::exp(-0.5 * t * t);
+}
+
+} // namespace
+
+Bootstrap::Bootstrap(
+  const ROOT::RDF::TH1DModel& model,
+  double fitLow,
+  double fitUp,
+  const double* initParams)
+  : m_nBins(model.fNbinsX)
+  , m_xLow(model.fXLow)
+  , m_xUp(model.fXUp)
+  , m_fitLow(fitLow)
+  , m_fitUp(fitUp)
+{
+  std::copy(initParams, initParams + 3, m_initParams);
+}
+
+BootstrapResult
+Bootstrap::run(
+  const std::vector<double>& values,
+  size_t nReplicas,
+  std::uint64_t seed,
+  ROOT::TThreadExecutor& executor) const
+{
+  // bin of each value, -1 for values outside of the fit window or the
+  // histogram. the axis of the model bins them exactly like the central
+  // fit; a value just below m_xUp can round into the overflow bin there.
+  std::vector<int> binIndex(values.size(), -1);
+  const TAxis axis(m_nBins, m_xLow, m_xUp);
+  for (size_t i = 0; i < values.size(); ++i) {
+    int bin = axis.FindFixBin(values[i]);
+    if (values[i] >= m_fitLow && values[i] < m_fitUp && bin >= 1
+        && bin <= m_nBins) {
+      binIndex[i] = bin - 1;
+    }
+  }
+
+  std::vector<double> replicas(nReplicas);
+  const unsigned nTasks =
+    (nReplicas + s_replicasPerTask - 1) / s_replicasPerTask;
+  executor.Foreach(
+    [this, &binIndex, seed, nReplicas, &replicas](unsigned task) {
+      size_t begin = task * s_replicasPerTask;
+      size_t end = std::min(begin + s_replicasPerTask, nReplicas);
+      fitReplicas(binIndex, seed, begin, end, replicas);
+    },
+    ROOT::TSeqU(nTasks));
+  return summarize(std::move(replicas));
+}
+
+std::uint64_t
+Bootstrap::makeSeed(const std::string& key)
+{
+  std::uint64_t seed = 0;
+
+  for (char c : key) {
+    seed = splitmix64(seed ^ static_cast<unsigned char>(c));
+  }
+  return seed;
+}
+
+// failed replicas are NaN and, like infinite ratios, do not enter the summary.
+BootstrapResult
+Bootstrap::summarize(std::vector<double> replicas)
+{
+  BootstrapResult result;
+
+  result.replicas = replicas;
+  replicas.erase(
+    std::remove_if(
+      replicas.begin(),
+      replicas.end(),
+      [](double value) { return !std::isfinite(value); }),
+    replicas.end());
+  if (replicas.size() < 2) {
+    return result;
+  }
+  std::sort(replicas.begin(), replicas.end());
+
+  double sum = 0.;
+  for (double value : replicas) {
+    sum += value;
+  }
+  result.mean = sum / replicas.size();
+  double sum2 = 0.;
+  for (double value : replicas) {
+    sum2 += (value - result.mean) * (value - result.mean);
+  }
+  result.stdDev = std::sqrt(sum2 / (replicas.size() - 1));
+
+  auto quantile = [&replicas](double q) {
+    double position = q * (replicas.size() - 1);
+    size_t index = static_cast<size_t>(position);
+    double fraction = position - index;
+    if (index + 1 >= replicas.size()) {
+      return replicas.back();
+    }
+    return replicas[index] * (1. - fraction) + replicas[index + 1] * fraction;
+  };
+  result.lower = quantile(0.158655);
+  result.upper = quantile(0.841345);
+  return result;
+}
+
+void
+Bootstrap::fitReplicas(
+  const std::vector<int>& binIndex,
+  std::uint64_t seed,
+  size_t begin,
+  size_t end,
+  std::vector<double>& replicas) const
+{
+  // detached from any directory so threads do not share a list.
+  TDirectory::TContext context(nullptr);
+  TH1D hist("bootstrap", "bootstrap", m_nBins, m_xLow, m_xUp);
+  TF1 gaus(
+    "bootstrapGaus",
+    gausFunction,
+    m_fitLow,
+    m_fitUp,
+    3,
+    1,
+    TF1::EAddToList::kNo);
+  std::vector<std::uint8_t> weights(binIndex.size());
+  std::vector<double> counts(m_nBins);
+  const double* cdf = poissonTable.cdf;
+
+  for (size_t replica = begin; replica < end; ++replica) {
+    std::uint64_t replicaSeed = splitmix64(seed + replica);
+    const size_t nValues = binIndex.size();
+
+    for (size_t i = 0; i < nValues; ++i) {
+      double u = (splitmix64(replicaSeed ^ i) >> 11) * 0x1.0p-53;
+      std::uint8_t weight = 0;
+      for (size_t k = 0; k < nPoissonThresholds; ++k) {
+        weight += u > cdf[k];
+      }
+      weights[i] = weight;
+    }
+    std::fill(counts.begin(), counts.end(), 0.);
+    for (size_t i = 0; i < nValues; ++i) {
+      if (binIndex[i] >= 0) {
+        counts[binIndex[i]] += weights[i];
+      }
+    }
+    hist.Reset();
+    for (int bin = 0; bin < m_nBins; ++bin) {
+      hist.SetBinContent(bin + 1, counts[bin]);
+    }
+    gaus.SetParameters(m_initParams[0], m_initParams[1], m_initParams[2]);
+    // replicas are fitted on several pool threads at once.
+    int status = concurrentFit(hist, gaus, "LQN0", m_fitLow, m_fitUp);
+    replicas[replica] = status == 0 ? gaus.GetParameter(1)
+                                    : std::numeric_limits<double>::quiet_NaN();
+  }
+}
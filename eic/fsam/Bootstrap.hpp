@@ -0,0 +1,72 @@
+#ifndef BOOTSTRAP_HPP
+#define BOOTSTRAP_HPP
+
+// C++
+#include <cstdint>
+#include <string>
+#include <vector>
+
+// ROOT
+#include "ROOT/RDataFrame.hxx"
+#include "ROOT/TThreadExecutor.hxx"
+
+// replicas of a fitted mean and their spread.
+// lower and upper bound the central 68.3% of the replicas.
+struct BootstrapResult
+{
+  std::vector<double> replicas;
+  double mean = 0.;
+  double stdDev = 0.;
+  double lower = 0.;
+  double upper = 0.;
+};
+
+/*
+ * bootstrap of the binned gaussian fit done by EventHist.
+ * values of a cell are cached once. every replica weights each value with
+ * Poisson(1), rebuilds the histogram from precomputed bin indices and refits
+ * in the same window, so no replica touches the input file again.
+ * replicas are spread over the tasks of the given executor.
+ */
+class Bootstrap
+{
+public:
+  Bootstrap(
+    const ROOT::RDF::TH1DModel& model,
+    double fitLow,
+    double fitUp,
+    const double* initParams);
+  ~Bootstrap() = default;
+  Bootstrap(const Bootstrap& bootstrap) = delete;
+  Bootstrap& operator=(const Bootstrap& bootstrap) = delete;
+
+  BootstrapResult run(
+    const std::vector<double>& values,
+    size_t nReplicas,
+    std::uint64_t seed,
+    ROOT::TThreadExecutor& executor) const;
+
+  static std::uint64_t makeSeed(const std::string& key);
+  static BootstrapResult summarize(std::vector<double> replicas);
+
+private:
+  void fitReplicas(
+    const std::vector<int>& binIndex,
+    std::uint64_t seed,
+    size_t begin,
+    size_t end,
+    std::vector<double>& replicas) const;
+
+private:
+  const int m_nBins;
+  const double m_xLow;
+  const double m_xUp;
+  const double m_fitLow;
+  const double m_fitUp;
+  double m_initParams[3];
+
+public:
+  static const size_t s_replicasPerTask;
+};
+
+#endif // BOOTSTRAP_HPP
@@ -0,0 +1,155 @@
+// C++
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <thread>
+
+// ROOT
+#include "TBranch.h"
+#include "TFile.h"
+#include "TObjArray.h"
+#include "TTree.h"
+
+#include <fmt/core.h>
+
+#include "CellScheduler.hpp"
+#include "Logger.hpp"
+#include "MemoryMonitor.hpp"
+
+const size_t CellScheduler::s_cellOverhead = 48 * 1048576;
+
+CellScheduler::CellScheduler(size_t memoryBudget, size_t nWorkers)
+  : m_memoryBudget(memoryBudget)
+  , m_nWorkers(nWorkers == 0 ? 1 : nWorkers)
+  , m_memoryInUse(0)
+  , m_nRunning(0)
+{
+}
+
+void
+CellScheduler::run(
+  const std::vector<Cell>& cells,
+  const std::function<void(const Cell&, size_t)>& work)
+{
+  std::vector<std::thread> threadVec;
+  std::atomic<size_t> next(0);
+
+  auto worker = [this, &cells, &work, &next](size_t index) {
+    for (size_t i = next++; i < cells.size(); i = next++) {
+      admit(cells[i]);
+      work(cells[i], index);
+      release(cells[i]);
+    }
+  };
+
+  Logger::info(
+    "scheduling {} cells on {} workers, memory budget {}",
+    cells.size(),
+    m_nWorkers,
+    m_memoryBudget == 0 ? "unlimited"
+                        : fmt::format("{} MB", m_memoryBudget / 1048576));
+  for (size_t i = 0; i < m_nWorkers && i < cells.size(); ++i) {
+    threadVec.emplace_back(worker, i);
+  }
+  for (auto& thread : threadVec) {
+    thread.join();
+  }
+}
+
+void
+CellScheduler::estimateMemory(
+  Cell& cell,
+  const std::vector<std::string>& branchNames)
+{
+  std::error_code error;
+  cell.fileSize = std::filesystem::file_size(cell.inputPath, error);
+  if (error) {
+    cell.fileSize = 0;
+  }
+  cell.memoryEstimate = s_cellOverhead + cell.fileSize;
+
+  TFile* file = TFile::Open(cell.inputPath.c_str(), "READ");
+  if (file == nullptr || file->IsOpen() == kFALSE) {
+    delete file;
+    return;
+  }
+  TTree* tree = file->Get<TTree>("events");
+  if (tree == nullptr || tree->GetEntries() == 0) {
+    delete file;
+    return;
+  }
+
+  // leaves of podio collections are split into sub-branches.
+  size_t zipBytes = 0;
+  size_t bufferBytes = 0;
+  std::function<void(TBranch*)> addBranch = [&](TBranch* branch) {
+    TObjArray* subBranches = branch->GetListOfBranches();
+    if (subBranches == nullptr || subBranches->GetEntriesFast() == 0) {
+      zipBytes += branch->GetZipBytes();
+      // compressed and uncompressed basket of the current entry.
+      bufferBytes += 2 * static_cast<size_t>(branch->GetBasketSize());
+      return;
+    }
+    for (int i = 0; i < subBranches->GetEntriesFast(); ++i) {
+      addBranch(static_cast<TBranch*>(subBranches->At(i)));
+    }
+  };
+  for (const auto& name : branchNames) {
+    TBranch* branch = tree->GetBranch(name.c_str());
+    if (branch != nullptr) {
+      addBranch(branch);
+    }
+  }
+
+  // tree cache holds the compressed baskets of one cluster.
+  size_t nEntries = tree->GetEntries();
+  cell.nEntries = nEntries;
+  size_t clusterEntries =
+    tree->GetAutoFlush() > 0 ? tree->GetAutoFlush() : nEntries;
+  if (clusterEntries > nEntries) {
+    clusterEntries = nEntries;
+  }
+  size_t cacheBytes = zipBytes * clusterEntries / nEntries;
+
+  cell.memoryEstimate = s_cellOverhead + cacheBytes + bufferBytes;
+  file->Close();
+  delete file;
+}
+
+void
+CellScheduler::sortLargestFirst(std::vector<Cell>& cells)
+{
+  std::stable_sort(cells.begin(), cells.end(), [](const Cell& a, const Cell& b) {
+    return a.fileSize > b.fileSize;
+  });
+}
+
+void
+CellScheduler::admit(const Cell& cell)
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  m_cv.wait(lock, [this, &cell]() {
+    return m_memoryBudget == 0 || m_nRunning == 0
+           || m_memoryInUse + cell.memoryEstimate <= m_memoryBudget;
+  });
+  m_memoryInUse += cell.memoryEstimate;
+  ++m_nRunning;
+  Logger::debug(
+    "{} admitted: estimate {:.1f} MB, in use {:.1f} MB, RSS {:.1f} MB",
+    cell.simInfo,
+    cell.memoryEstimate / 1048576.,
+    m_memoryInUse / 1048576.,
+    MemoryMonitor::currentRss() / 1048576.);
+}
+
+void
+CellScheduler::release(const Cell& cell)
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_memoryInUse -= cell.memoryEstimate;
+    --m_nRunning;
+  }
+  m_cv.notify_all();
+}
@@ -0,0 +1,71 @@
+#ifndef CELLSCHEDULER_HPP
+#define CELLSCHEDULER_HPP
+
+// C++
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <string>
+#include <vector>
+
+// one (energy, eta) point of the grid and its input file.
+struct Cell
+{
+  size_t energyBin;
+  size_t etaBin;
+  std::string simInfo;
+  std::string inputPath;
+  // bytes, filled by CellScheduler::estimateMemory().
+  size_t fileSize = 0;
+  size_t memoryEstimate = 0;
+  size_t nEntries = 0;
+};
+
+/*
+ * runs cells on a fixed number of worker threads.
+ * a cell is admitted only if the sum of memory estimates of running cells
+ * stays under the budget. a cell is always admitted when nothing else runs,
+ * so a cell larger than the budget still makes progress alone.
+ * budget 0 means no limit.
+ */
+class CellScheduler
+{
+public:
+  CellScheduler(size_t memoryBudget, size_t nWorkers);
+  ~CellScheduler() = default;
+
+  CellScheduler(const CellScheduler& scheduler) = delete;
+  CellScheduler& operator=(const CellScheduler& scheduler) = delete;
+
+  // work gets the cell and the index of the worker running it.
+  void run(
+    const std::vector<Cell>& cells,
+    const std::function<void(const Cell&, size_t)>& work);
+
+  // memory footprint of a cell from its file size and layout of the branches
+  // it reads: per-cell overhead + tree cache for one cluster + basket buffers.
+  static void
+  estimateMemory(Cell& cell, const std::vector<std::string>& branchNames);
+
+  // biggest files first, so the longest cells do not start last and leave
+  // one worker running alone at the end. ties keep the grid order.
+  static void sortLargestFirst(std::vector<Cell>& cells);
+
+private:
+  void admit(const Cell& cell);
+  void release(const Cell& cell);
+
+private:
+  const size_t m_memoryBudget;
+  const size_t m_nWorkers;
+  size_t m_memoryInUse;
+  size_t m_nRunning;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+
+public:
+  // RDataFrame graph, cloned histograms, canvas and fit.
+  static const size_t s_cellOverhead;
+};
+
+#endif // CELLSCHEDULER_HPP
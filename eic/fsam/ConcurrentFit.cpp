@@ -0,0 +1,54 @@
+// ROOT
+#include "Fit/DataRange.h"
+#include "Foption.h"
+#include "HFitInterface.h"
+#include "Math/MinimizerOptions.h"
+
+#include "ConcurrentFit.hpp"
+
+namespace
+{
+
+ROOT::Math::MinimizerOptions
+minuit2Options()
+{
+  ROOT::Math::MinimizerOptions options;
+  options.SetMinimizerType("Minuit2");
+  options.SetMinimizerAlgorithm("Migrad");
+  return options;
+}
+
+} // namespace
+
+// what TH1::Fit does, with the minimizer options of this fit only.
+int
+concurrentFit(
+  TH1& hist,
+  TF1& function,
+  const char* option,
+  double low,
+  double up)
+{
+  Foption_t fitOption;
+  ROOT::Fit::FitOptionsMake(
+    ROOT::Fit::EFitObjectType::kHistogram, option, fitOption);
+  ROOT::Fit::DataRange range(low, up);
+  return ROOT::Fit::FitObject(
+    &hist, &function, fitOption, minuit2Options(), "", range);
+}
+
+int
+concurrentFit(
+  TGraph& graph,
+  TF1& function,
+  const char* option,
+  double low,
+  double up)
+{
+  Foption_t fitOption;
+  ROOT::Fit::FitOptionsMake(
+    ROOT::Fit::EFitObjectType::kGraph, option, fitOption);
+  ROOT::Fit::DataRange range(low, up);
+  return ROOT::Fit::FitObject(
+    &graph, &function, fitOption, minuit2Options(), "", range);
+}
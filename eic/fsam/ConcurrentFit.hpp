@@ -0,0 +1,32 @@
+#ifndef CONCURRENTFIT_HPP
+#define CONCURRENTFIT_HPP
+
+// ROOT
+#include "TF1.h"
+#include "TGraph.h"
+#include "TH1.h"
+
+/*
+ * TH1::Fit and TGraph::Fit with Minuit2, for fits that run on several
+ * threads at once. Fit() uses the default minimizer, TMinuit, whose state is
+ * the gMinuit global; Minuit2 keeps it in the minimizer of each fit.
+ * option, range and the returned status are those of Fit(). the default
+ * minimizer is left alone, so the fits of a cell without --fit-ladder or
+ * --bootstrap are unchanged.
+ */
+int
+concurrentFit(
+  TH1& hist,
+  TF1& function,
+  const char* option,
+  double low,
+  double up);
+int
+concurrentFit(
+  TGraph& graph,
+  TF1& function,
+  const char* option,
+  double low,
+  double up);
+
+#endif // CONCURRENTFIT_HPP
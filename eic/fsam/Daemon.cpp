@@ -0,0 +1,298 @@
+// C++
+#include <cerrno>
+#include <chrono>
+#include <climits>
+#include <csignal>
+#include <cstring>
+#include <iostream>
+#include <sstream>
+#include <thread>
+
+// POSIX
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+// ROOT
+#include "ROOT/RDataFrame.hxx"
+#include "TClass.h"
+#include "TROOT.h"
+
+#include "Daemon.hpp"
+#include "Logger.hpp"
+
+int
+runFsam(const std::vector<std::string>& words, std::ostream& err);
+int
+runEdepRatio(const std::vector<std::string>& words, std::ostream& err);
+
+const char* const Daemon::s_protocol = "fsam-daemon 1";
+const unsigned Daemon::s_readTimeoutS = 10;
+const size_t Daemon::s_nReaders = 4;
+const unsigned Daemon::s_pollMs = 200;
+
+namespace
+{
+
+// requests are a few command line words; anything longer is not a client.
+const size_t maxRequestSize = 1 << 16;
+
+// event data types read by HistManager.
+const char* const warmUpClasses[] = { "edm4eic::CalorimeterHitData",
+                                      "edm4eic::ReconstructedParticleData",
+                                      "edm4hep::SimCalorimeterHitData",
+                                      "edm4hep::MCParticleData" };
+
+// jobs change the working directory, the socket is unlinked at exit.
+std::string
+absolutePath(const std::string& path)
+{
+  char workingDirectory[PATH_MAX];
+
+  if (path.empty() || path[0] == '/'
+      || getcwd(workingDirectory, sizeof(workingDirectory)) == nullptr) {
+    return path;
+  }
+  return std::string(workingDirectory) + "/" + path;
+}
+
+} // namespace
+
+Daemon::Daemon(const std::string& socketPath)
+  : m_socketPath(absolutePath(socketPath))
+  , m_listenFd(-1)
+  , m_nQueued(0)
+  , m_isStopped(false)
+  , m_jobs(1)
+  , m_readers(s_nReaders)
+{
+}
+
+Daemon::~Daemon()
+{
+  if (m_listenFd >= 0) {
+    close(m_listenFd);
+    unlink(m_socketPath.c_str());
+  }
+}
+
+int
+Daemon::run()
+{
+  // a client leaving early must not kill the daemon.
+  std::signal(SIGPIPE, SIG_IGN);
+  if (listen() == false) {
+    return 1;
+  }
+  warmUp();
+  Logger::info("serving on {}", m_socketPath);
+
+  // polled, so a stop read by a reader ends the loop.
+  while (m_isStopped == false) {
+    pollfd listenPoll{ m_listenFd, POLLIN, 0 };
+    int nReady = poll(&listenPoll, 1, s_pollMs);
+    if (nReady < 0 && errno != EINTR) {
+      Logger::error("poll: {}", std::strerror(errno));
+      return 1;
+    }
+    if (nReady <= 0) {
+      continue;
+    }
+    int fd = accept(m_listenFd, nullptr, nullptr);
+    if (fd < 0) {
+      if (errno == EBADF || errno == EINVAL || errno == ENOTSOCK) {
+        Logger::error("accept: {}", std::strerror(errno));
+        return 1;
+      }
+      // a client gone before it was accepted, or no descriptor left for
+      // now; the daemon and its running job are fine.
+      if (errno != EINTR && errno != EAGAIN && errno != ECONNABORTED) {
+        Logger::warning("accept: {}", std::strerror(errno));
+        std::this_thread::sleep_for(std::chrono::milliseconds(s_pollMs));
+      }
+      continue;
+    }
+    m_readers.submit([this, fd]() { serve(fd); });
+  }
+  Logger::info("stop requested, {} jobs left", m_nQueued.load());
+  return 0;
+}
+
+// reads the request of a client and queues its job, on a reader thread.
+void
+Daemon::serve(int fd)
+{
+  Request request;
+
+  if (readRequest(fd, request) == false) {
+    sendLine(fd, "err invalid request");
+    sendLine(fd, "exit 1");
+    close(fd);
+    return;
+  }
+  if (request.program == "stop") {
+    m_isStopped = true;
+    sendLine(fd, "exit 0");
+    close(fd);
+    return;
+  }
+  sendLine(fd, "queued " + std::to_string(m_nQueued++));
+  m_jobs.submit([this, fd, request]() {
+    runJob(fd, request);
+    close(fd);
+    --m_nQueued;
+  });
+}
+
+// refuses a socket another daemon still answers on, replaces a stale one.
+bool
+Daemon::listen()
+{
+  sockaddr_un address{};
+
+  if (m_socketPath.size() >= sizeof(address.sun_path)) {
+    Logger::error("socket path too long: {}", m_socketPath);
+    return false;
+  }
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, m_socketPath.c_str());
+
+  int probe = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (probe >= 0
+      && connect(probe, reinterpret_cast<sockaddr*>(&address), sizeof(address))
+           == 0) {
+    close(probe);
+    Logger::error("a daemon is already serving on {}", m_socketPath);
+    return false;
+  }
+  if (probe >= 0) {
+    close(probe);
+  }
+  unlink(m_socketPath.c_str());
+
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  mode_t mask = umask(077);
+  bool isBound =
+    fd >= 0
+    && bind(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address)) == 0;
+  umask(mask);
+  if (isBound == false || ::listen(fd, 16) != 0) {
+    Logger::error("cannot listen on {}: {}", m_socketPath, std::strerror(errno));
+    if (fd >= 0) {
+      close(fd);
+    }
+    return false;
+  }
+  // accept() must not block when a polled client has gone meanwhile.
+  fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+  m_listenFd = fd;
+  return true;
+}
+
+// loads the dictionaries of the event data and runs a JIT compiled event
+// loop, the startup every direct invocation pays before reading data.
+void
+Daemon::warmUp()
+{
+  LogContext context("warm-up");
+
+  for (const char* className : warmUpClasses) {
+    if (TClass::GetClass(className) == nullptr) {
+      Logger::warning("no dictionary for {}", className);
+    }
+  }
+  ROOT::RDataFrame frame(1);
+  auto sum = frame.Define("x", "1.").Sum<double>("x");
+  Logger::debug("warm-up event loop: {}", *sum);
+}
+
+bool
+Daemon::readRequest(int fd, Request& request)
+{
+  timeval timeout{ s_readTimeoutS, 0 };
+  std::string buffer;
+  char chunk[4096];
+
+  setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+  while (buffer.find("\n\n") == std::string::npos) {
+    ssize_t n = recv(fd, chunk, sizeof(chunk), 0);
+    if (n <= 0 || buffer.size() + n > maxRequestSize) {
+      return false;
+    }
+    buffer.append(chunk, n);
+  }
+  buffer.resize(buffer.find("\n\n") + 1);
+
+  std::istringstream ss(buffer);
+  std::string protocol;
+  if (!std::getline(ss, protocol) || protocol != s_protocol
+      || !std::getline(ss, request.workingDirectory)
+      || !std::getline(ss, request.program)) {
+    return false;
+  }
+  std::string arg;
+  while (std::getline(ss, arg)) {
+    request.args.push_back(arg);
+  }
+  return request.program == "fsam" || request.program == "ratio"
+         || request.program == "stop";
+}
+
+void
+Daemon::runJob(int fd, const Request& request)
+{
+  std::ostringstream err;
+  int status = 1;
+
+  if (chdir(request.workingDirectory.c_str()) != 0) {
+    err << "cannot enter " << request.workingDirectory << "\n";
+  } else {
+    Logger::setLevel(Logger::kInfo);
+    Logger::setSink([fd](Logger::Level level, const std::string& line) {
+      sendLine(
+        fd,
+        (level >= Logger::kWarning ? "err " : "out ")
+          + line.substr(0, line.size() - 1));
+    });
+    try {
+      status = request.program == "fsam" ? runFsam(request.args, err)
+                                         : runEdepRatio(request.args, err);
+    } catch (const std::exception& e) {
+      err << "error: " << e.what() << "\n";
+      status = 1;
+    }
+    Logger::flush();
+    Logger::setSink(nullptr);
+    if (ROOT::IsImplicitMTEnabled()) {
+      ROOT::DisableImplicitMT();
+    }
+  }
+
+  std::istringstream lines(err.str());
+  std::string line;
+  while (std::getline(lines, line)) {
+    sendLine(fd, "err " + line);
+  }
+  sendLine(fd, "exit " + std::to_string(status));
+}
+
+void
+Daemon::sendLine(int fd, const std::string& line)
+{
+  std::string message = line + "\n";
+  const char* data = message.data();
+  size_t size = message.size();
+
+  while (size > 0) {
+    ssize_t n = send(fd, data, size, MSG_NOSIGNAL);
+    if (n <= 0) {
+      return;
+    }
+    data += n;
+    size -= n;
+  }
+}
@@ -0,0 +1,81 @@
+#ifndef DAEMON_HPP
+#define DAEMON_HPP
+
+// C++
+#include <atomic>
+#include <string>
+#include <vector>
+
+#include "ThreadPool.hpp"
+
+/*
+ * fsam --serve SOCKET: resident fsam process running the command lines sent
+ * by fsamc over a Unix socket, so ROOT, the edm4eic / edm4hep dictionaries
+ * and the RDataFrame JIT are initialized once instead of per invocation.
+ *
+ * request, one field per line, ended by an empty line:
+ *   fsam-daemon 1
+ *   <working directory of the client>
+ *   fsam | ratio | stop
+ *   <argument>...
+ * reply, one message per line:
+ *   queued <jobs ahead>
+ *   out <stdout line>
+ *   err <stderr line>
+ *   exit <status>
+ *
+ * requests are read on a few reader threads with a timeout, so a slow or
+ * idle client holds up no other; accept errors that concern one connection
+ * or a passing lack of descriptors are logged and serving goes on.
+ * jobs run one at a time in submission order. working directory, log level
+ * and implicit MT are process wide and are reset for every job, so a job
+ * writes the same files as its command line run directly. only the fsam
+ * Logger is streamed; ROOT's own messages stay on the daemon's stderr.
+ * the socket is only accessible by the user running the daemon.
+ */
+class Daemon
+{
+public:
+  explicit Daemon(const std::string& socketPath);
+  ~Daemon();
+
+  Daemon(const Daemon& daemon) = delete;
+  Daemon& operator=(const Daemon& daemon) = delete;
+
+  // serves until a stop request, then finishes the queued jobs.
+  int run();
+
+  static const char* const s_protocol;
+
+private:
+  struct Request
+  {
+    std::string workingDirectory;
+    std::string program;
+    std::vector<std::string> args;
+  };
+
+  bool listen();
+  void warmUp();
+  void serve(int fd);
+  bool readRequest(int fd, Request& request);
+  void runJob(int fd, const Request& request);
+
+  static void sendLine(int fd, const std::string& line);
+
+private:
+  const std::string m_socketPath;
+  int m_listenFd;
+  std::atomic<size_t> m_nQueued;
+  std::atomic<bool> m_isStopped;
+  // one worker: jobs share the process wide state. destroyed after the
+  // readers, which may still queue jobs, and before the rest of the daemon.
+  ThreadPool m_jobs;
+  ThreadPool m_readers;
+
+  static const unsigned s_readTimeoutS;
+  static const size_t s_nReaders;
+  static const unsigned s_pollMs;
+};
+
+#endif // DAEMON_HPP
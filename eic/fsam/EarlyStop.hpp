@@ -0,0 +1,137 @@
+#ifndef EARLYSTOP_HPP
+#define EARLYSTOP_HPP
+
+// C++
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ROOT
+#include "ROOT/RDataFrame.hxx"
+#include "TTreeReader.h"
+
+// events of a cell used before its target precision was reached.
+struct EarlyStop
+{
+  ULong64_t nEvents = 0;
+  // relative error on the mean of the watched column.
+  double relError = 0.;
+  bool isStopped = false;
+};
+
+/*
+ * RDataFrame action of --target-precision watching one column of a cell.
+ * every slot keeps n, sum and sum of squares of the column; every
+ * s_checkEvery events of a slot the sums of all slots give the relative
+ * error sigma / sqrt(n) / |mean|. once it is below the target the shared
+ * flag is raised, and the gate Filter placed before the selection rejects
+ * the remaining events before any of their columns is read.
+ *
+ * sums of other slots are read while they are written, so they are
+ * relaxed atomics stored only by their own slot. events already past the
+ * gate when the flag is raised still fill everything, so with implicit MT
+ * the events used depend on scheduling.
+ */
+class EarlyStopHelper : public ROOT::Detail::RDF::RActionImpl<EarlyStopHelper>
+{
+public:
+  using Result_t = EarlyStop;
+
+  EarlyStopHelper(
+    double targetPrecision,
+    std::shared_ptr<std::atomic<bool>> isStopped,
+    unsigned nSlots)
+    : m_targetPrecision(targetPrecision)
+    , m_isStopped(std::move(isStopped))
+    , m_partials(nSlots)
+    , m_result(std::make_shared<EarlyStop>())
+  {
+  }
+  EarlyStopHelper(EarlyStopHelper&& helper) = default;
+  EarlyStopHelper(const EarlyStopHelper& helper) = delete;
+
+  std::shared_ptr<Result_t> GetResultPtr() const
+  {
+    return m_result;
+  }
+
+  void Initialize() {}
+  void InitTask(TTreeReader*, unsigned int) {}
+
+  void Exec(unsigned int slot, double value)
+  {
+    Partial& partial = m_partials[slot];
+
+    if (!std::isfinite(value)) {
+      return;
+    }
+    partial.sum.store(
+      partial.sum.load(std::memory_order_relaxed) + value,
+      std::memory_order_relaxed);
+    partial.sum2.store(
+      partial.sum2.load(std::memory_order_relaxed) + value * value,
+      std::memory_order_relaxed);
+    ULong64_t n = partial.n.load(std::memory_order_relaxed) + 1;
+    partial.n.store(n, std::memory_order_relaxed);
+    if (n % s_checkEvery == 0 && relError() < m_targetPrecision) {
+      m_isStopped->store(true, std::memory_order_relaxed);
+    }
+  }
+
+  void Finalize()
+  {
+    m_result->nEvents = 0;
+    for (const auto& partial : m_partials) {
+      m_result->nEvents += partial.n.load();
+    }
+    m_result->relError = relError();
+    m_result->isStopped = m_isStopped->load();
+  }
+
+  std::string GetActionName()
+  {
+    return "EarlyStop";
+  }
+
+  // checks start once the sums are meaningful.
+  static const ULong64_t s_minEvents = 1000;
+  static const ULong64_t s_checkEvery = 256;
+
+private:
+  // infinite below s_minEvents or for a zero mean.
+  double relError() const
+  {
+    double n = 0.;
+    double sum = 0.;
+    double sum2 = 0.;
+
+    for (const auto& partial : m_partials) {
+      n += partial.n.load(std::memory_order_relaxed);
+      sum += partial.sum.load(std::memory_order_relaxed);
+      sum2 += partial.sum2.load(std::memory_order_relaxed);
+    }
+    if (n < s_minEvents || sum == 0.) {
+      return HUGE_VAL;
+    }
+    double mean = sum / n;
+    double variance = std::max(sum2 / n - mean * mean, 0.);
+    return std::sqrt(variance / n) / std::fabs(mean);
+  }
+
+  struct alignas(64) Partial
+  {
+    std::atomic<ULong64_t> n{ 0 };
+    std::atomic<double> sum{ 0. };
+    std::atomic<double> sum2{ 0. };
+  };
+
+  const double m_targetPrecision;
+  std::shared_ptr<std::atomic<bool>> m_isStopped;
+  std::vector<Partial> m_partials;
+  std::shared_ptr<EarlyStop> m_result;
+};
+
+#endif // EARLYSTOP_HPP
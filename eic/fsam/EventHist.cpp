@@ -1,6 +1,14 @@
+#include <algorithm>
+#include <cmath>
+#include <memory>
+#include <optional>
+
 #include "EventHist.hpp"
+#include "Logger.hpp"
+#include "PerfCounters.hpp"
 
 std::string EventHist::s_pathPrefix;
+bool EventHist::s_isReproducible = false;
 
 EventHist::EventHist(
   const std::string& columnName,
@@ -9,67 +17,231 @@ EventHist::EventHist(
   : m_columnName(columnName)
   , m_simInfo(simInfo)
   , m_columnInfo(columnInfo)
+  , m_isBooked(false)
+  , m_nReplicas(0)
+  , m_executor(nullptr)
+  , m_fitLadder(nullptr)
+  , m_sigma(0., 0.)
 {
   std::string name = fmt::format("{}_{}", m_columnName, simInfo);
   m_columnInfo.fName = name;
 }
 
 // member functions
+void
+EventHist::book(ROOT::RDF::RNode& dataNode)
+{
+  // values are cached in the same event loop for the bootstrap.
+  if (m_nReplicas > 0) {
+    m_values = dataNode.Take<double>(m_columnName);
+  }
+  // typed, so booking does not go through the interpreter. every column of
+  // HistManager is a double.
+  m_hist1D = dataNode.Histo1D<double>(m_columnInfo, m_columnName);
+  m_isBooked = true;
+}
+
+void
+EventHist::setBootstrap(size_t nReplicas, ROOT::TThreadExecutor* executor)
+{
+  m_nReplicas = executor == nullptr ? 0 : nReplicas;
+  m_executor = executor;
+}
+
+void
+EventHist::setFitLadder(const FitLadder* fitLadder)
+{
+  m_fitLadder = fitLadder;
+}
+
+const BootstrapResult&
+EventHist::getBootstrap() const
+{
+  return m_bootstrap;
+}
+
+const std::pair<double, double>&
+EventHist::getGausFitSigma() const
+{
+  return m_sigma;
+}
+
+const std::string&
+EventHist::getColumnName() const
+{
+  return m_columnName;
+}
+
+// fit of the chosen strategy, or 0 with a warning if no strategy converged.
+// the bootstrap refits a gaussian in the window of the chosen strategy.
+std::pair<double, double>
+EventHist::useFitLadder(
+  const std::vector<FitOutcome>& outcomes,
+  int best,
+  double* fitParams,
+  double& downFit,
+  double& upFit)
+{
+  for (const auto& outcome : outcomes) {
+    Logger::debug(
+      "{} {}: status {}, mean {:.5g}, chi2/ndf {:.3g}",
+      m_columnName,
+      outcome.strategy,
+      outcome.status,
+      outcome.params.empty() ? 0. : outcome.params[1],
+      outcome.chi2PerNdf());
+  }
+  if (best < 0) {
+    Logger::warning("{} no fit strategy converged", m_columnName);
+    return { 0., 0. };
+  }
+  const FitOutcome& outcome = outcomes[best];
+  if (best > 0 && outcomes.front().isValid() == false) {
+    Logger::info(
+      "{} recovered by {} after {} failed",
+      m_columnName,
+      outcome.strategy,
+      outcomes.front().strategy);
+  }
+  for (int i = 0; i < 3; ++i) {
+    fitParams[i] = outcome.params[i];
+  }
+  downFit = outcome.low;
+  upFit = outcome.up;
+  m_sigma.first = outcome.params[2];
+  m_sigma.second = outcome.errors[2];
+  return { outcome.params[1], outcome.errors[1] };
+}
+
 std::pair<double, double>
 EventHist::getGausFitMean(ROOT::RDF::RNode& dataNode, bool draw = false)
 {
   TCanvas* cvs;
   static std::mutex mtx;
+  LogContext logContext("fit");
 
   (void)cvs;
-  m_hist1D = dataNode.Histo1D(m_columnInfo, m_columnName);
-  auto nEvents = dataNode.Count();
-  (void)*nEvents;
-  // std::cout << ".";
-  while (m_hist1D.IsReady() == kFALSE)
-    std::cout << "hist1D is not ready\r";
-  std::cout << '\n';
+  if (m_isBooked == false) {
+    book(dataNode);
+  }
+  // dereferencing runs the event loop; no need to poll IsReady().
+  std::optional<PerfScope> perfScope;
+  perfScope.emplace(PerfCounters::kEventLoop);
+  const TH1D& result = *m_hist1D;
+  perfScope.reset();
+  // strategies after the first rung run on the executor before the drawing
+  // lock is taken.
+  std::vector<FitOutcome> outcomes;
+  if (m_fitLadder != nullptr) {
+    PerfScope fitScope(PerfCounters::kFit);
+    outcomes = m_fitLadder->run(result);
+  }
   mtx.lock();
   if (draw) {
     cvs = new TCanvas(m_columnInfo.fName, m_columnInfo.fName, 700, 500);
   }
-  TH1D* hist1D = static_cast<TH1D*>(m_hist1D->Clone(m_columnInfo.fName));
+  TH1D* hist1D = static_cast<TH1D*>(result.Clone(m_columnInfo.fName));
+  if (s_isReproducible == true) {
+    // bin contents are integer counts and merge exactly; the running sums
+    // behind GetMean() and GetStdDev() do not.
+    hist1D->ResetStats();
+  }
   hist1D->SetLineWidth(2);
   hist1D->SetLineColor(kBlue);
-  hist1D->Draw("PE");
+  // without a canvas Draw() would open a default one shared by all cells.
+  if (draw) {
+    hist1D->Draw("PE");
+  }
   std::pair<double, double> gausFitMean;
+  double fitParams[3] = { 0., 0., 0. };
   double upFit = hist1D->GetMean() + 5. * hist1D->GetStdDev();
   double downFit = hist1D->GetMean() - 1. * hist1D->GetStdDev();
   double up = hist1D->GetMean() + 5. * hist1D->GetStdDev();
   double down = hist1D->GetMean() - 5. * hist1D->GetStdDev();
-  Int_t fitResult = hist1D->Fit("gaus", "L", "", downFit, upFit);
-  std::cout << "fitResult=" << fitResult << '\n';
-  if (fitResult < 0) {
-    std::cout
-      << "@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@\n";
-    std::cout << "fitResult < 0\n";
-    std::cout
-      << "@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@@\n";
-    gausFitMean.first = 0;
-    gausFitMean.second = 0;
+  // drawn function of the ladder, alive until the canvas is saved.
+  std::unique_ptr<TF1> ladderFunction;
+  if (m_fitLadder != nullptr) {
+    // the first rung is the fit below without the ladder, in the same window
+    // and with the same minimizer, so it gives the same result when it wins.
+    perfScope.emplace(PerfCounters::kFit);
+    Int_t fitResult = hist1D->Fit("gaus", "L0", "", downFit, upFit);
+    perfScope.reset();
+    outcomes.insert(
+      outcomes.begin(),
+      FitLadder::original(
+        *hist1D, hist1D->GetFunction("gaus"), fitResult, downFit, upFit));
+    int best = FitLadder::choose(outcomes);
+    gausFitMean = useFitLadder(outcomes, best, fitParams, downFit, upFit);
+    if (best >= 0) {
+      hist1D->GetXaxis()->SetRangeUser(down, up);
+      ladderFunction = FitLadder::makeFunction(
+        outcomes[best], fmt::format("{}_fit", m_columnInfo.fName));
+      ladderFunction->SetLineWidth(2);
+      ladderFunction->SetLineColor(kRed);
+      if (draw) {
+        ladderFunction->Draw("same");
+      }
+    }
   } else {
-    hist1D->GetXaxis()->SetRangeUser(down, up);
-    TF1* gaus = hist1D->GetFunction("gaus");
-    gausFitMean.first = gaus->GetParameter(1);
-    if (gausFitMean.first < 0) {
-      std::cout << "mean value is less than 0. function will return 0.\n";
+    perfScope.emplace(PerfCounters::kFit);
+    Int_t fitResult =
+      hist1D->Fit("gaus", draw ? "L" : "L0", "", downFit, upFit);
+    perfScope.reset();
+    Logger::debug("{} fitResult={}", m_columnName, fitResult);
+    if (fitResult < 0) {
+      Logger::warning("{} fit failed with status {}", m_columnName, fitResult);
       gausFitMean.first = 0;
       gausFitMean.second = 0;
+    } else {
+      hist1D->GetXaxis()->SetRangeUser(down, up);
+      TF1* gaus = hist1D->GetFunction("gaus");
+      gausFitMean.first = gaus->GetParameter(1);
+      if (gausFitMean.first < 0) {
+        Logger::warning("{} mean is less than 0, returning 0", m_columnName);
+        gausFitMean.first = 0;
+        gausFitMean.second = 0;
+      }
+      gausFitMean.second = gaus->GetParError(1);
+      for (int i = 0; i < 3; ++i) {
+        fitParams[i] = gaus->GetParameter(i);
+      }
+      if (gausFitMean.first > 0) {
+        m_sigma.first = std::abs(gaus->GetParameter(2));
+        m_sigma.second = gaus->GetParError(2);
+      }
+      gaus->SetLineWidth(2);
+      gaus->SetLineColor(kRed);
     }
-    gausFitMean.second = gaus->GetParError(1);
-    gaus->SetLineWidth(2);
-    gaus->SetLineColor(kRed);
   }
-  std::cout << "simInfo=" << m_simInfo << '\n';
   if (draw) {
+    PerfScope renderScope(PerfCounters::kRender);
     cvs->SaveAs(
       fmt::format("{}{}_{}.pdf", s_pathPrefix, m_simInfo, m_columnName).c_str());
+    // canvas and clone are not needed after saving; keeping them made
+    // memory grow with the number of cells.
+    delete cvs;
   }
+  delete hist1D;
   mtx.unlock();
+
+  // replicas run outside of the lock; refits are independent of the canvas.
+  if (m_nReplicas > 0 && gausFitMean.first > 0) {
+    LogContext bootstrapContext("bootstrap");
+    if (s_isReproducible == true) {
+      std::sort(m_values->begin(), m_values->end());
+    }
+    Bootstrap bootstrap(m_columnInfo, downFit, upFit, fitParams);
+    m_bootstrap = bootstrap.run(
+      *m_values,
+      m_nReplicas,
+      Bootstrap::makeSeed(m_columnName + m_simInfo),
+      *m_executor);
+    Logger::info(
+      "{} bootstrap: {} replicas, std {:.3g}, fit error {:.3g}",
+      m_columnName,
+      m_nReplicas,
+      m_bootstrap.stdDev,
+      gausFitMean.second);
+  }
   return gausFitMean;
 }
@@ -5,11 +5,15 @@
 #include <mutex>
 
 #include "ROOT/RDataFrame.hxx"
+#include "ROOT/TThreadExecutor.hxx"
 #include "TCanvas.h"
 #include "TF1.h"
 #include "TGraph2DErrors.h"
 #include "TH1D.h"
 
+#include "Bootstrap.hpp"
+#include "FitLadder.hpp"
+
 class EventHist
 {
 public:
@@ -24,17 +28,48 @@ public:
   EventHist& operator=(const EventHist& hist) = delete;
 
   // member functions
+  // books the histogram, and the bootstrap values, without running the event
+  // loop, so several EventHists of a cell fill in one pass.
+  // getGausFitMean() books on its own if this was not called.
+  void book(ROOT::RDF::RNode& dataNode);
   std::pair<double, double>
   getGausFitMean(ROOT::RDF::RNode& dataNode, bool draw);
+  // refit nReplicas bootstrap replicas as tasks of the executor after the
+  // gaussian fit. call before book().
+  void setBootstrap(size_t nReplicas, ROOT::TThreadExecutor* executor);
+  const BootstrapResult& getBootstrap() const;
+  // fit the other strategies of the ladder too and keep the best of them and
+  // the single likelihood gaussian fit.
+  void setFitLadder(const FitLadder* fitLadder);
+  // width of the last gaussian fit and its error. 0 if the fit failed.
+  const std::pair<double, double>& getGausFitSigma() const;
+  const std::string& getColumnName() const;
 
 private:
+  std::pair<double, double> useFitLadder(
+    const std::vector<FitOutcome>& outcomes,
+    int best,
+    double* fitParams,
+    double& downFit,
+    double& upFit);
+
   const std::string m_columnName;
   const std::string m_simInfo;
   ROOT::RDF::TH1DModel m_columnInfo;
   ROOT::RDF::RResultPtr<TH1D> m_hist1D;
+  ROOT::RDF::RResultPtr<std::vector<double>> m_values;
+  bool m_isBooked;
+  size_t m_nReplicas;
+  ROOT::TThreadExecutor* m_executor;
+  const FitLadder* m_fitLadder;
+  BootstrapResult m_bootstrap;
+  std::pair<double, double> m_sigma;
 
 public:
   static std::string s_pathPrefix;
+  // fit window from statistics of the bin contents and sorted bootstrap
+  // values, so neither depends on how events were spread over slots.
+  static bool s_isReproducible;
 };
 
 #endif // EVENTHIST_HPP
@@ -0,0 +1,49 @@
+#ifndef EXACTSUM_HPP
+#define EXACTSUM_HPP
+
+// C++
+#include <cmath>
+#include <cstdint>
+
+/*
+ * order independent sum of doubles in 128 bit fixed point.
+ * every term is rounded toward zero to a multiple of 2^-80 once, then
+ * integer additions are exact and associative, so any order or partition of
+ * the terms gives the same bits.
+ * a term is split into its integer and fraction parts at 2^-40 with two
+ * hardware conversions, which limits terms to |value| < 2^23 (GeV here).
+ */
+class ExactSum
+{
+public:
+  ExactSum() = default;
+
+  ExactSum& operator+=(double value)
+  {
+    // scaling by powers of 2 and subtracting the truncated part are exact.
+    double scaled = value * s_halfScale;
+    std::int64_t high = static_cast<std::int64_t>(scaled);
+    std::int64_t low =
+      static_cast<std::int64_t>((scaled - static_cast<double>(high)) * s_halfScale);
+    m_sum += static_cast<__int128>(high) * s_halfUnit + low;
+    return *this;
+  }
+  ExactSum& operator+=(const ExactSum& other)
+  {
+    m_sum += other.m_sum;
+    return *this;
+  }
+  explicit operator double() const
+  {
+    return std::ldexp(static_cast<double>(m_sum), -2 * s_halfBits);
+  }
+
+private:
+  __int128 m_sum = 0;
+
+  static constexpr int s_halfBits = 40;
+  static constexpr double s_halfScale = 1099511627776.; // 2^40
+  static constexpr __int128 s_halfUnit = static_cast<__int128>(1) << s_halfBits;
+};
+
+#endif // EXACTSUM_HPP
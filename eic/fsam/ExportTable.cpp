@@ -0,0 +1,173 @@
+// C++
+#include <algorithm>
+
+#ifdef FSAM_WITH_ARROW
+// Arrow
+#include "arrow/api.h"
+#include "arrow/io/file.h"
+#include "arrow/ipc/writer.h"
+#include "parquet/arrow/writer.h"
+#endif
+
+#include "ExportTable.hpp"
+#include "Logger.hpp"
+
+ExportTable::ExportTable(const std::string& schema, int version)
+  : m_schema(schema)
+  , m_version(version)
+{
+}
+
+void
+ExportTable::addColumn(const std::string& name, std::vector<std::int64_t> values)
+{
+  m_columns.push_back(Column{ name, kInt64, std::move(values), {}, {} });
+}
+
+void
+ExportTable::addColumn(const std::string& name, std::vector<double> values)
+{
+  m_columns.push_back(Column{ name, kDouble, {}, std::move(values), {} });
+}
+
+void
+ExportTable::addColumn(const std::string& name, std::vector<std::string> values)
+{
+  m_columns.push_back(Column{ name, kString, {}, {}, std::move(values) });
+}
+
+size_t
+ExportTable::nRows() const
+{
+  if (m_columns.empty()) {
+    return 0;
+  }
+  const Column& column = m_columns.front();
+  return column.type == kInt64    ? column.int64s.size()
+         : column.type == kDouble ? column.doubles.size()
+                                  : column.strings.size();
+}
+
+bool
+ExportTable::parseFormat(const std::string& name, Format& format)
+{
+  if (name == "arrow") {
+    format = kArrow;
+  } else if (name == "parquet") {
+    format = kParquet;
+  } else {
+    return false;
+  }
+  return true;
+}
+
+#ifdef FSAM_WITH_ARROW
+
+bool
+ExportTable::isAvailable()
+{
+  return true;
+}
+
+bool
+ExportTable::write(const std::string& pathStem, Format format) const
+{
+  std::string path = pathStem + (format == kParquet ? ".parquet" : ".arrow");
+  const int64_t nRow = static_cast<int64_t>(nRows());
+  arrow::FieldVector fields;
+  arrow::ArrayVector arrays;
+
+  for (const auto& column : m_columns) {
+    std::shared_ptr<arrow::Array> array;
+    if (column.type == kInt64 && int64_t(column.int64s.size()) == nRow) {
+      // numeric buffers point into the column vectors, no copy.
+      array = std::make_shared<arrow::Int64Array>(
+        nRow, arrow::Buffer::Wrap(column.int64s));
+      fields.push_back(arrow::field(column.name, arrow::int64(), false));
+    } else if (column.type == kDouble && int64_t(column.doubles.size()) == nRow) {
+      array = std::make_shared<arrow::DoubleArray>(
+        nRow, arrow::Buffer::Wrap(column.doubles));
+      fields.push_back(arrow::field(column.name, arrow::float64(), false));
+    } else if (column.type == kString && int64_t(column.strings.size()) == nRow) {
+      // strings need offsets, so they are the one column that is copied.
+      arrow::StringBuilder builder;
+      if (builder.AppendValues(column.strings).ok() == false
+          || builder.Finish(&array).ok() == false) {
+        Logger::error("cannot build column {} of {}", column.name, path);
+        return false;
+      }
+      fields.push_back(arrow::field(column.name, arrow::utf8(), false));
+    } else {
+      Logger::error("column {} of {} has a wrong length", column.name, path);
+      return false;
+    }
+    arrays.push_back(array);
+  }
+
+  auto metadata = arrow::key_value_metadata(
+    { "fsam.schema", "fsam.schema_version" },
+    { m_schema, std::to_string(m_version) });
+  auto schema = arrow::schema(fields, metadata);
+  auto outputResult = arrow::io::FileOutputStream::Open(path);
+  if (outputResult.ok() == false) {
+    Logger::error(
+      "cannot open file {}: {}", path, outputResult.status().ToString());
+    return false;
+  }
+  std::shared_ptr<arrow::io::FileOutputStream> output = *outputResult;
+  arrow::Status status;
+
+  if (format == kParquet) {
+    auto table = arrow::Table::Make(schema, arrays, nRow);
+    // the Arrow schema is stored too, so the metadata survives.
+    status = parquet::arrow::WriteTable(
+      *table,
+      arrow::default_memory_pool(),
+      output,
+      std::max<int64_t>(nRow, 1),
+      parquet::default_writer_properties(),
+      parquet::ArrowWriterProperties::Builder().store_schema()->build());
+  } else {
+    // one uncompressed record batch, so readers can map the file and use the
+    // buffers in place.
+    auto batch = arrow::RecordBatch::Make(schema, nRow, arrays);
+    auto writerResult = arrow::ipc::MakeFileWriter(output, schema);
+    if (writerResult.ok() == false) {
+      status = writerResult.status();
+    } else {
+      std::shared_ptr<arrow::ipc::RecordBatchWriter> writer = *writerResult;
+      status = writer->WriteRecordBatch(*batch);
+      if (status.ok()) {
+        status = writer->Close();
+      }
+    }
+  }
+  if (status.ok()) {
+    status = output->Close();
+  }
+  if (status.ok() == false) {
+    Logger::error("cannot write {}: {}", path, status.ToString());
+    return false;
+  }
+  Logger::info("{} rows are written to {}", nRow, path);
+  return true;
+}
+
+#else
+
+bool
+ExportTable::isAvailable()
+{
+  return false;
+}
+
+bool
+ExportTable::write(const std::string& pathStem, Format format) const
+{
+  (void)format;
+  Logger::error(
+    "cannot write {}: built without Arrow, rebuild with make ARROW=1", pathStem);
+  return false;
+}
+
+#endif
@@ -0,0 +1,64 @@
+#ifndef EXPORTTABLE_HPP
+#define EXPORTTABLE_HPP
+
+// C++
+#include <cstdint>
+#include <string>
+#include <vector>
+
+/*
+ * columnar result table for readers without ROOT.
+ * columns are added in schema order. write() wraps the numeric vectors as
+ * Arrow buffers without copying and writes either an Arrow IPC file, which
+ * consumers can memory map, or a Parquet file.
+ * the schema carries "fsam.schema" and "fsam.schema_version" metadata; a
+ * change of columns of a schema must bump its version.
+ * without FSAM_WITH_ARROW (make ARROW=1) nothing can be written.
+ */
+class ExportTable
+{
+public:
+  enum Format
+  {
+    kNone = 0,
+    kArrow = 1,
+    kParquet = 2
+  };
+
+  ExportTable(const std::string& schema, int version);
+  ~ExportTable() = default;
+
+  void addColumn(const std::string& name, std::vector<std::int64_t> values);
+  void addColumn(const std::string& name, std::vector<double> values);
+  void addColumn(const std::string& name, std::vector<std::string> values);
+
+  size_t nRows() const;
+  // appends ".arrow" or ".parquet" to pathStem. false and logs on error.
+  bool write(const std::string& pathStem, Format format) const;
+
+  static bool isAvailable();
+  static bool parseFormat(const std::string& name, Format& format);
+
+private:
+  enum Type
+  {
+    kInt64,
+    kDouble,
+    kString
+  };
+  struct Column
+  {
+    std::string name;
+    Type type;
+    std::vector<std::int64_t> int64s;
+    std::vector<double> doubles;
+    std::vector<std::string> strings;
+  };
+
+private:
+  const std::string m_schema;
+  const int m_version;
+  std::vector<Column> m_columns;
+};
+
+#endif // EXPORTTABLE_HPP
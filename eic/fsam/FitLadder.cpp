@@ -0,0 +1,245 @@
+// C++
+#include <algorithm>
+#include <cmath>
+#include <limits>
+
+// ROOT
+#include "TDirectory.h"
+#include "TF1.h"
+
+#include "ConcurrentFit.hpp"
+#include "FitLadder.hpp"
+
+// windows of the gaussian fits narrow from the original [-1, +5] sigma fit,
+// the first rung, towards the core where tails or pile-up spoil a wide
+// window.
+const std::vector<FitLadder::Strategy> FitLadder::s_strategies{
+  { "gausL-2+2", false, "L", false, 2., 2. },
+  { "gausL-1.5+1.5peak", false, "L", true, 1.5, 1.5 },
+  { "gausChi2-2+3", false, "", false, 2., 3. },
+  { "crystalBallL-5+3", true, "L", false, 5., 3. }
+};
+
+namespace
+{
+
+double
+gausFunction(double* x, double* p)
+{
+  double t = (x[0] - p[1]) / p[2];
+  return p[0] * std::exp(-0.5 * t * t);
+}
+
+} // namespace
+
+bool
+FitOutcome::isValid() const
+{
+  return status == 0 && ndf > 0 && params.size() >= 3 && params[1] > 0.
+         && params[1] > low && params[1] < up && params[2] > 0.
+         && std::isfinite(errors[1]) && std::isfinite(chi2);
+}
+
+double
+FitOutcome::chi2PerNdf() const
+{
+  return ndf > 0 ? chi2 / ndf : std::numeric_limits<double>::infinity();
+}
+
+FitLadder::FitLadder(ROOT::TThreadExecutor& executor)
+  : m_executor(executor)
+{
+}
+
+double
+FitLadder::crystalBall(double* x, double* p)
+{
+  double t = (x[0] - p[1]) / p[2];
+  double alpha = std::abs(p[3]);
+  double n = p[4];
+
+  if (t > -alpha) {
+    return p[0] * std::exp(-0.5 * t * t);
+  }
+  double a = std::pow(n / alpha, n) * std::exp(-0.5 * alpha * alpha);
+  double b = n / alpha - alpha;
+  return p[0] * a * std::pow(b - t, -n);
+}
+
+std::unique_ptr<TF1>
+FitLadder::makeFunction(const FitOutcome& outcome, const std::string& name)
+{
+  auto function = std::make_unique<TF1>(
+    name.c_str(),
+    outcome.isCrystalBall ? crystalBall : gausFunction,
+    outcome.low,
+    outcome.up,
+    static_cast<int>(outcome.params.size()),
+    1,
+    TF1::EAddToList::kNo);
+  for (size_t i = 0; i < outcome.params.size(); ++i) {
+    function->SetParameter(i, outcome.params[i]);
+  }
+  return function;
+}
+
+std::vector<FitOutcome>
+FitLadder::run(const TH1D& hist) const
+{
+  Binned binned = makeBinned(hist);
+
+  return m_executor.Map(
+    [&binned](unsigned i) { return fit(s_strategies[i], binned); },
+    ROOT::TSeqU(s_strategies.size()));
+}
+
+FitOutcome
+FitLadder::original(
+  const TH1D& hist,
+  const TF1* function,
+  int status,
+  double low,
+  double up)
+{
+  FitOutcome outcome;
+
+  outcome.strategy = "gausL-1+5";
+  outcome.status = status;
+  outcome.low = low;
+  outcome.up = up;
+  if (function == nullptr) {
+    return outcome;
+  }
+  for (int i = 0; i < 3; ++i) {
+    outcome.params.push_back(function->GetParameter(i));
+    outcome.errors.push_back(function->GetParError(i));
+  }
+  outcome.params[2] = std::abs(outcome.params[2]);
+  score(outcome, makeBinned(hist), *function);
+  return outcome;
+}
+
+int
+FitLadder::choose(const std::vector<FitOutcome>& outcomes)
+{
+  int best = -1;
+
+  for (size_t i = 0; i < outcomes.size(); ++i) {
+    const FitOutcome& outcome = outcomes[i];
+    if (outcome.isValid()
+        && (best < 0 || outcome.chi2PerNdf() < outcomes[best].chi2PerNdf())) {
+      best = static_cast<int>(i);
+    }
+  }
+  return best;
+}
+
+FitLadder::Binned
+FitLadder::makeBinned(const TH1D& hist)
+{
+  Binned binned;
+  const int nBins = hist.GetNbinsX();
+  double sum = 0.;
+  double sumX = 0.;
+  double sumX2 = 0.;
+  double maxContent = -1.;
+
+  // statistics from the bin contents, so they do not depend on how events
+  // were spread over slots.
+  binned.contents.resize(nBins);
+  binned.xLow = hist.GetXaxis()->GetXmin();
+  binned.xUp = hist.GetXaxis()->GetXmax();
+  binned.peak = 0.;
+  for (int bin = 1; bin <= nBins; ++bin) {
+    double content = hist.GetBinContent(bin);
+    double x = hist.GetBinCenter(bin);
+    binned.contents[bin - 1] = content;
+    sum += content;
+    sumX += content * x;
+    sumX2 += content * x * x;
+    if (content > maxContent) {
+      maxContent = content;
+      binned.peak = x;
+    }
+  }
+  binned.mean = sum > 0. ? sumX / sum : 0.;
+  binned.stdDev =
+    sum > 0. ? std::sqrt(std::max(sumX2 / sum - binned.mean * binned.mean, 0.))
+             : 0.;
+  return binned;
+}
+
+FitOutcome
+FitLadder::fit(const Strategy& strategy, const Binned& binned)
+{
+  FitOutcome outcome;
+  const int nBins = static_cast<int>(binned.contents.size());
+  const int nParams = strategy.isCrystalBall ? 5 : 3;
+  double center = strategy.isPeakCentered ? binned.peak : binned.mean;
+
+  outcome.strategy = strategy.name;
+  outcome.isCrystalBall = strategy.isCrystalBall;
+  outcome.low = std::max(center - strategy.lowSigmas * binned.stdDev, binned.xLow);
+  outcome.up = std::min(center + strategy.upSigmas * binned.stdDev, binned.xUp);
+  if (!(binned.stdDev > 0.) || !(outcome.up > outcome.low)) {
+    return outcome;
+  }
+
+  // detached from any directory so threads do not share a list.
+  TDirectory::TContext context(nullptr);
+  TH1D hist("fitLadder", "fitLadder", nBins, binned.xLow, binned.xUp);
+  for (int bin = 0; bin < nBins; ++bin) {
+    hist.SetBinContent(bin + 1, binned.contents[bin]);
+  }
+  double maxContent =
+    *std::max_element(binned.contents.begin(), binned.contents.end());
+  TF1 function(
+    "fitLadderFunction",
+    strategy.isCrystalBall ? crystalBall : gausFunction,
+    outcome.low,
+    outcome.up,
+    nParams,
+    1,
+    TF1::EAddToList::kNo);
+  function.SetParameter(0, maxContent);
+  function.SetParameter(1, center);
+  function.SetParameter(2, binned.stdDev);
+  function.SetParLimits(2, 1e-3 * binned.stdDev, 10. * binned.stdDev);
+  if (strategy.isCrystalBall) {
+    function.SetParameter(3, 1.5);
+    function.SetParameter(4, 3.);
+    function.SetParLimits(3, 0.2, 5.);
+    function.SetParLimits(4, 1.01, 50.);
+  }
+  std::string option = strategy.option + "QN0";
+  // runs on several threads at once.
+  outcome.status =
+    concurrentFit(hist, function, option.c_str(), outcome.low, outcome.up);
+  for (int i = 0; i < nParams; ++i) {
+    outcome.params.push_back(function.GetParameter(i));
+    outcome.errors.push_back(function.GetParError(i));
+  }
+  outcome.params[2] = std::abs(outcome.params[2]);
+  score(outcome, binned, function);
+  return outcome;
+}
+
+// Neyman chi2 over the non-empty bins whose centres are in the window.
+void
+FitLadder::score(FitOutcome& outcome, const Binned& binned, const TF1& function)
+{
+  const int nBins = static_cast<int>(binned.contents.size());
+  const double binWidth = (binned.xUp - binned.xLow) / nBins;
+  int nUsed = 0;
+  for (int bin = 0; bin < nBins; ++bin) {
+    double x = binned.xLow + (bin + 0.5) * binWidth;
+    double content = binned.contents[bin];
+    if (x < outcome.low || x > outcome.up || content <= 0.) {
+      continue;
+    }
+    double residual = content - function.Eval(x);
+    outcome.chi2 += residual * residual / content;
+    ++nUsed;
+  }
+  outcome.ndf = nUsed - static_cast<int>(outcome.params.size());
+}
@@ -0,0 +1,112 @@
+#ifndef FITLADDER_HPP
+#define FITLADDER_HPP
+
+// C++
+#include <memory>
+#include <string>
+#include <vector>
+
+// ROOT
+#include "TF1.h"
+#include "ROOT/TThreadExecutor.hxx"
+#include "TH1D.h"
+
+// result of one fit strategy on a cell histogram.
+// params are norm, mean and sigma, then alpha and n for the Crystal Ball.
+struct FitOutcome
+{
+  std::string strategy;
+  bool isCrystalBall = false;
+  int status = -1;
+  std::vector<double> params;
+  std::vector<double> errors;
+  double low = 0.;
+  double up = 0.;
+  // Neyman chi2 of the fitted function over the non-empty bins of the window,
+  // computed the same way for every strategy so they can be compared.
+  double chi2 = 0.;
+  int ndf = 0;
+
+  bool isValid() const;
+  double chi2PerNdf() const;
+};
+
+/*
+ * fits a cell histogram with several strategies at once as tasks of an
+ * executor and keeps the best one: only converged fits with a positive mean
+ * and width inside the histogram range are candidates, and among them the
+ * smallest chi2/ndf wins.
+ * the first rung is the likelihood gaussian fit of a cell without the ladder,
+ * done by the caller with the same call and minimizer and turned into an
+ * outcome by original(), so a cell it wins for has the same result as
+ * without the ladder. run() fits the other strategies; every task fills its
+ * own detached histogram from the bin contents, so the source histogram is
+ * only read.
+ */
+class FitLadder
+{
+public:
+  explicit FitLadder(ROOT::TThreadExecutor& executor);
+  ~FitLadder() = default;
+  FitLadder(const FitLadder& ladder) = delete;
+  FitLadder& operator=(const FitLadder& ladder) = delete;
+
+  // outcome of every strategy after the first rung, in ladder order.
+  std::vector<FitOutcome> run(const TH1D& hist) const;
+
+  // outcome of the first rung from the fitted function of the caller, null
+  // if the fit did not attach one. low and up are its window.
+  static FitOutcome original(
+    const TH1D& hist,
+    const TF1* function,
+    int status,
+    double low,
+    double up);
+
+  // index of the valid outcome with the smallest chi2/ndf, -1 if none is.
+  static int choose(const std::vector<FitOutcome>& outcomes);
+
+  // function of the outcome with its fitted parameters, for drawing.
+  static std::unique_ptr<TF1>
+  makeFunction(const FitOutcome& outcome, const std::string& name);
+
+  // norm, mean, sigma, alpha, n. the tail is on the low side.
+  static double crystalBall(double* x, double* p);
+
+private:
+  struct Strategy
+  {
+    std::string name;
+    bool isCrystalBall;
+    // "L" for a binned likelihood fit, "" for chi2.
+    std::string option;
+    // window in units of the histogram standard deviation around the mean
+    // or, if isPeakCentered, around the most populated bin.
+    bool isPeakCentered;
+    double lowSigmas;
+    double upSigmas;
+  };
+
+  // binned histogram of a cell and its statistics from the bin contents.
+  struct Binned
+  {
+    std::vector<double> contents;
+    double xLow;
+    double xUp;
+    double mean;
+    double stdDev;
+    double peak;
+  };
+
+  static Binned makeBinned(const TH1D& hist);
+  static FitOutcome fit(const Strategy& strategy, const Binned& binned);
+  static void
+  score(FitOutcome& outcome, const Binned& binned, const TF1& function);
+
+private:
+  ROOT::TThreadExecutor& m_executor;
+
+  static const std::vector<Strategy> s_strategies;
+};
+
+#endif // FITLADDER_HPP
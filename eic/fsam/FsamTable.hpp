@@ -0,0 +1,345 @@
+#ifndef FSAMTABLE_HPP
+#define FSAMTABLE_HPP
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <limits>
+#include <string>
+#include <vector>
+
+/*
+ * fsam(E, eta) lookup table measured on the (energy, eta) grid.
+ * header only and independent of ROOT, so reconstruction code can use it.
+ *
+ * file layout (native byte order; read() rejects a table written on a
+ * machine of the other order by its version):
+ *   char[8]   magic "FSAMLUT"
+ *   uint32    version, nEnergy, nEta, interpolation, extrapolation
+ *   double    energy[nEnergy]   bin centers, increasing
+ *   double    eta[nEta]         bin centers, increasing
+ *   float     value[nEnergy * nEta], energy major
+ *
+ * energy is interpolated in log(E) since fsam varies slowly with log(E).
+ * lookup() does not allocate and is safe to call from many threads.
+ */
+class FsamTable
+{
+public:
+  enum Interpolation : std::uint32_t
+  {
+    kBilinear = 0,
+    kBicubic = 1
+  };
+  enum Extrapolation : std::uint32_t
+  {
+    // value at the nearest edge of the grid.
+    kClamp = 0,
+    // continue the slope of the edge interval.
+    kLinear = 1
+  };
+
+  FsamTable() = default;
+  ~FsamTable() = default;
+
+  // returns false and leaves the table empty on any error.
+  bool read(const std::string& path)
+  {
+    std::ifstream ifs(path, std::ios::binary);
+    char magic[8];
+    std::uint32_t header[5];
+
+    m_values.clear();
+    if (!ifs.read(magic, sizeof(magic)) || std::memcmp(magic, s_magic, 8) != 0
+        || !ifs.read(reinterpret_cast<char*>(header), sizeof(header))
+        || header[0] != s_version || header[1] < 2 || header[2] < 2
+        || header[1] > s_maxPoints || header[2] > s_maxPoints
+        || header[3] > kBicubic || header[4] > kLinear) {
+      return false;
+    }
+    // the sizes must match the file before anything is allocated for them.
+    std::streamoff headerSize = ifs.tellg();
+    ifs.seekg(0, std::ios::end);
+    std::streamoff dataSize = ifs.tellg() - headerSize;
+    ifs.seekg(headerSize);
+    if (dataSize
+        != std::streamoff(
+          (header[1] + header[2]) * sizeof(double)
+          + std::uint64_t(header[1]) * header[2] * sizeof(float))) {
+      return false;
+    }
+    m_interpolation = static_cast<Interpolation>(header[3]);
+    m_extrapolation = static_cast<Extrapolation>(header[4]);
+    m_energy.resize(header[1]);
+    m_eta.resize(header[2]);
+    m_values.resize(m_energy.size() * m_eta.size());
+    if (!ifs.read(
+          reinterpret_cast<char*>(m_energy.data()),
+          m_energy.size() * sizeof(double))
+        || !ifs.read(
+          reinterpret_cast<char*>(m_eta.data()), m_eta.size() * sizeof(double))
+        || !ifs.read(
+          reinterpret_cast<char*>(m_values.data()),
+          m_values.size() * sizeof(float))) {
+      m_values.clear();
+      return false;
+    }
+    std::vector<double> logEnergy(m_energy.size());
+    for (size_t i = 0; i < m_energy.size(); ++i) {
+      if (!(m_energy[i] > 0.)) {
+        m_values.clear();
+        return false;
+      }
+      logEnergy[i] = std::log(m_energy[i]);
+    }
+    if (m_energyAxis.build(logEnergy) == false || m_etaAxis.build(m_eta) == false) {
+      m_values.clear();
+      return false;
+    }
+    return true;
+  }
+
+  /*
+   * writes a table from a measured grid.
+   * cells with valid == 0 (failed fit, missing file) are filled from valid
+   * neighbours, then nSmooth passes of a [1 2 1] kernel along energy are
+   * applied. grid values are energy major like the file.
+   */
+  static bool write(
+    const std::string& path,
+    const std::vector<double>& energy,
+    const std::vector<double>& eta,
+    std::vector<double> values,
+    std::vector<char> valid,
+    Interpolation interpolation,
+    Extrapolation extrapolation,
+    unsigned nSmooth)
+  {
+    const size_t nEnergy = energy.size();
+    const size_t nEta = eta.size();
+
+    if (nEnergy < 2 || nEta < 2 || nEnergy > s_maxPoints || nEta > s_maxPoints
+        || values.size() != nEnergy * nEta || valid.size() != values.size()) {
+      return false;
+    }
+    fillInvalid(nEnergy, nEta, values, valid);
+    for (unsigned pass = 0; pass < nSmooth; ++pass) {
+      std::vector<double> smoothed(values);
+      for (size_t i = 1; i + 1 < nEnergy; ++i) {
+        for (size_t j = 0; j < nEta; ++j) {
+          smoothed[i * nEta + j] = 0.25 * values[(i - 1) * nEta + j]
+                                   + 0.5 * values[i * nEta + j]
+                                   + 0.25 * values[(i + 1) * nEta + j];
+        }
+      }
+      values.swap(smoothed);
+    }
+
+    std::ofstream ofs(path, std::ios::binary);
+    std::uint32_t header[5] = { s_version,
+                                static_cast<std::uint32_t>(nEnergy),
+                                static_cast<std::uint32_t>(nEta),
+                                interpolation,
+                                extrapolation };
+    std::vector<float> compact(values.begin(), values.end());
+
+    ofs.write(s_magic, 8);
+    ofs.write(reinterpret_cast<const char*>(header), sizeof(header));
+    ofs.write(
+      reinterpret_cast<const char*>(energy.data()), nEnergy * sizeof(double));
+    ofs.write(reinterpret_cast<const char*>(eta.data()), nEta * sizeof(double));
+    ofs.write(
+      reinterpret_cast<const char*>(compact.data()),
+      compact.size() * sizeof(float));
+    return ofs.good();
+  }
+
+  bool isLoaded() const
+  {
+    return m_values.empty() == false;
+  };
+
+  // NaN for a NaN argument. energies at or below zero get the value at the
+  // lowest energy of the grid.
+  double lookup(double energy, double eta) const
+  {
+    if (std::isnan(energy) || std::isnan(eta)) {
+      return std::numeric_limits<double>::quiet_NaN();
+    }
+    double u;
+    double v;
+    double logEnergy =
+      energy > 0. ? std::log(energy) : m_energyAxis.points.front();
+    size_t i = locate(m_energyAxis, logEnergy, u);
+    size_t j = locate(m_etaAxis, eta, v);
+
+    if (m_interpolation == kBicubic) {
+      return bicubic(i, j, u, v);
+    }
+    return (1. - u) * ((1. - v) * at(i, j) + v * at(i, j + 1))
+           + u * ((1. - v) * at(i + 1, j) + v * at(i + 1, j + 1));
+  }
+
+private:
+  /*
+   * grid axis with a uniform index over sub-intervals narrower than the
+   * smallest grid spacing, so locating a value is one multiply, one table
+   * read and one compare instead of a search.
+   */
+  struct Axis
+  {
+    std::vector<double> points;
+    std::vector<double> invWidth;
+    std::vector<std::uint16_t> start;
+    double invStep = 0.;
+
+    bool build(const std::vector<double>& values)
+    {
+      double minWidth = values.back() - values.front();
+
+      points = values;
+      invWidth.resize(points.size() - 1);
+      for (size_t k = 0; k + 1 < points.size(); ++k) {
+        double width = points[k + 1] - points[k];
+        if (!(width > 0.)) {
+          return false;
+        }
+        invWidth[k] = 1. / width;
+        minWidth = std::min(minWidth, width);
+      }
+      size_t nSteps = static_cast<size_t>(
+        std::ceil(2. * (points.back() - points.front()) / minWidth));
+      if (nSteps > s_maxSteps) {
+        return false;
+      }
+      invStep = nSteps / (points.back() - points.front());
+      start.assign(nSteps + 1, 0);
+      for (size_t m = 0; m <= nSteps; ++m) {
+        double x = points.front() + m / invStep;
+        size_t k = 0;
+        while (k + 2 < points.size() && points[k + 1] <= x) {
+          ++k;
+        }
+        start[m] = static_cast<std::uint16_t>(k);
+      }
+      return true;
+    }
+  };
+
+  double at(size_t i, size_t j) const
+  {
+    return m_values[i * m_eta.size() + j];
+  }
+
+  // interval [axis[k], axis[k + 1]] and position t in it.
+  // t is outside of [0, 1] only when extrapolating linearly.
+  size_t locate(const Axis& axis, double x, double& t) const
+  {
+    const std::vector<double>& points = axis.points;
+    double position = (x - points.front()) * axis.invStep;
+    position = std::min(std::max(position, 0.), double(axis.start.size() - 1));
+    size_t k = axis.start[static_cast<size_t>(position)];
+
+    // a sub-interval holds at most one grid point.
+    k += (k + 2 < points.size()) && (points[k + 1] <= x);
+    t = (x - points[k]) * axis.invWidth[k];
+    if (m_extrapolation == kClamp) {
+      t = std::min(std::max(t, 0.), 1.);
+    }
+    return k;
+  }
+
+  // Catmull-Rom spline in index space over the 4x4 neighbourhood.
+  double bicubic(size_t i, size_t j, double u, double v) const
+  {
+    const size_t nEnergy = m_energy.size();
+    const size_t nEta = m_eta.size();
+    double rows[4];
+
+    for (long di = -1; di <= 2; ++di) {
+      size_t ii = clampIndex(long(i) + di, nEnergy);
+      double p[4];
+      for (long dj = -1; dj <= 2; ++dj) {
+        p[dj + 1] = at(ii, clampIndex(long(j) + dj, nEta));
+      }
+      rows[di + 1] = catmullRom(p, v);
+    }
+    return catmullRom(rows, u);
+  }
+
+  static size_t clampIndex(long index, size_t size)
+  {
+    return static_cast<size_t>(std::min(std::max(index, 0L), long(size) - 1));
+  }
+
+  static double catmullRom(const double* p, double t)
+  {
+    return p[1]
+           + 0.5 * t
+               * (p[2] - p[0]
+                  + t * (2. * p[0] - 5. * p[1] + 4. * p[2] - p[3]
+                         + t * (3. * (p[1] - p[2]) + p[3] - p[0])));
+  }
+
+  // average of valid neighbours, repeated until every cell has a value.
+  static void fillInvalid(
+    size_t nEnergy,
+    size_t nEta,
+    std::vector<double>& values,
+    std::vector<char>& valid)
+  {
+    bool isChanged = true;
+
+    while (isChanged) {
+      isChanged = false;
+      std::vector<char> nextValid(valid);
+      for (size_t i = 0; i < nEnergy; ++i) {
+        for (size_t j = 0; j < nEta; ++j) {
+          if (valid[i * nEta + j]) {
+            continue;
+          }
+          double sum = 0.;
+          int n = 0;
+          const long di[4] = { -1, 1, 0, 0 };
+          const long dj[4] = { 0, 0, -1, 1 };
+          for (int k = 0; k < 4; ++k) {
+            long ii = long(i) + di[k];
+            long jj = long(j) + dj[k];
+            if (ii < 0 || jj < 0 || ii >= long(nEnergy) || jj >= long(nEta)
+                || valid[ii * nEta + jj] == 0) {
+              continue;
+            }
+            sum += values[ii * nEta + jj];
+            ++n;
+          }
+          if (n > 0) {
+            values[i * nEta + j] = sum / n;
+            nextValid[i * nEta + j] = 1;
+            isChanged = true;
+          }
+        }
+      }
+      valid.swap(nextValid);
+    }
+  }
+
+private:
+  std::vector<double> m_energy;
+  std::vector<double> m_eta;
+  std::vector<float> m_values;
+  Axis m_energyAxis;
+  Axis m_etaAxis;
+  Interpolation m_interpolation = kBilinear;
+  Extrapolation m_extrapolation = kClamp;
+
+  static constexpr const char* s_magic = "FSAMLUT";
+  static const std::uint32_t s_version = 1;
+  static const size_t s_maxSteps = 1 << 16;
+  // Axis::start holds interval indices in 16 bits.
+  static const std::uint32_t s_maxPoints = 65535;
+};
+
+#endif // FSAMTABLE_HPP
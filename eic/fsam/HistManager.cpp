@@ -1,5 +1,11 @@
 // C++
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
+#include <filesystem>
 #include <fmt/core.h>
+#include <fstream>
 #include <mutex>
 #include <thread>
 #include <utility>
@@ -10,7 +16,18 @@
 #include "edm4hep/MCParticleCollection.h"
 #include "edm4hep/SimCalorimeterHitData.h"
 
+#include "TFile.h"
+#include "TGraph2DErrors.h"
+#include "TH1D.h"
+#include "TROOT.h"
+#include "TTree.h"
+
+#include "ExactSum.hpp"
 #include "HistManager.hpp"
+#include "Logger.hpp"
+#include "PerfCounters.hpp"
+#include "ShowerProfile.hpp"
+#include "ThreadPool.hpp"
 
 // vector of pairs of <column name, TH1D model>
 static const std::vector<std::pair<std::string, ROOT::RDF::TH1DModel>>
@@ -38,39 +55,228 @@ static const std::vector<std::pair<std::string, ROOT::RDF::TH1DModel>>
         "Total deposited energy in BIC; Total deposited energy in BIC [GeV]; Events",
         500,
         0.0,
+        20.0 } },
+    std::pair{
+      "closure",
+      ROOT::RDF::TH1DModel{
+        "closure",
+        "Corrected over generated energy; Corrected energy / generated energy; Events",
+        400,
+        0.0,
+        2.0 } }
+  };
+
+// columns of the Imaging layers and of the whole barrel for --imaging.
+// ScFi columns keep the names of histTable.
+static const std::vector<std::pair<std::string, ROOT::RDF::TH1DModel>>
+  subsystemRecTable{
+    std::pair{
+      "recEnergyImaging",
+      ROOT::RDF::TH1DModel{
+        "recEnergyImaging",
+        "Reconstructed Imaging energy; Reconstructed energy [GeV]; Events",
+        500,
+        0.0,
+        0.2 } },
+    std::pair{
+      "fsamImaging",
+      ROOT::RDF::TH1DModel{
+        "fsamImaging",
+        "Imaging sampling fraction; Sampling fraction; Events",
+        400,
+        0.0,
+        0.02 } },
+    std::pair{
+      "recEnergyTotal",
+      ROOT::RDF::TH1DModel{
+        "recEnergyTotal",
+        "Reconstructed ScFi + Imaging energy; Reconstructed energy [GeV]; Events",
+        500,
+        0.0,
+        2.0 } },
+    std::pair{
+      "fsamTotal",
+      ROOT::RDF::TH1DModel{
+        "fsamTotal",
+        "ScFi + Imaging sampling fraction; Sampling fraction; Events",
+        400,
+        0.0,
+        0.2 } }
+  };
+
+static const std::vector<std::pair<std::string, ROOT::RDF::TH1DModel>>
+  subsystemSimTable{
+    std::pair{
+      "simEnergyImaging",
+      ROOT::RDF::TH1DModel{
+        "simEnergyImaging",
+        "Deposited energy in Imaging layers; Deposited energy [GeV]; Events",
+        500,
+        0.0,
+        20.0 } },
+    std::pair{
+      "simEnergyTotal",
+      ROOT::RDF::TH1DModel{
+        "simEnergyTotal",
+        "Total deposited energy in BIC; Total deposited energy in BIC [GeV]; Events",
+        500,
+        0.0,
         20.0 } }
   };
 
+// fitted columns of the cells export. the schema is fixed per mode: columns
+// that were not fitted in a run, like the closure without --fsam-table, are
+// NaN. adding a column needs a new schema version in writeExport().
+static const std::vector<std::string> recResultColumns{
+  "recEnergy",      "fsam",        "closure",   "recEnergyImaging",
+  "fsamImaging",    "recEnergyTotal", "fsamTotal"
+};
+static const std::vector<std::string> simResultColumns{ "simEnergy",
+                                                        "simEnergyImaging",
+                                                        "simEnergyTotal" };
+static const int cellsSchemaVersion = 1;
+static const int eventsSchemaVersion = 1;
+
+// conversions are templated on the accumulator: double for the fast mode,
+// ExactSum for --reproducible where the result must not depend on hit order.
+// the ones looping over hits are the conversion stage of --perf-counters.
+template<typename Sum>
 double
 convertGenEnergy(
   const std::vector<edm4eic::ReconstructedParticleData>& generatedParticles)
 {
-  double sum = 0.0;
+  PerfScope perfScope(PerfCounters::kConversion);
+  Sum sum{};
   for (const auto& particle : generatedParticles) {
     sum += particle.energy;
   }
-  return sum / generatedParticles.size(); // instead of generatedParticles[0]
+  return double(sum) / generatedParticles.size(); // instead of generatedParticles[0]
 };
 
+// events between progress reports of an RDataFrame slot.
+static const size_t progressStep = 1000;
+
+// guards the results cell workers append to: bootstrap rows, profiles,
+// event rows and cut flows.
+static std::mutex histMutex;
+
+// sampling fraction applied by eicrecon to ScFi hit energies.
+static const double eicrecon_fsam = 0.10200085;
+
+template<typename Sum>
 double
 convertRecEnergy(const std::vector<edm4eic::CalorimeterHitData>& event)
 {
-  const double eicrecon_fsam = 0.10200085;
-  double sum = 0.0;
+  PerfScope perfScope(PerfCounters::kConversion);
+  Sum sum{};
   for (const auto& hit : event) {
     sum += hit.energy;
   }
-  return sum * eicrecon_fsam;
+  return double(sum) * eicrecon_fsam;
 };
 
+// sampling fraction applied by eicrecon to Imaging hit energies. must match
+// the EcalBarrelImagingRecHits configuration of the reconstruction.
+static const double eicrecon_imaging_fsam = 0.00619766;
+
+template<typename Sum>
+double
+convertImagingRecEnergy(const std::vector<edm4eic::CalorimeterHitData>& event)
+{
+  PerfScope perfScope(PerfCounters::kConversion);
+  Sum sum{};
+  for (const auto& hit : event) {
+    sum += hit.energy;
+  }
+  return double(sum) * eicrecon_imaging_fsam;
+};
+
+double
+convertTotalEnergy(double scfiEnergy, double imagingEnergy)
+{
+  return scfiEnergy + imagingEnergy;
+};
+
+// recEnergy with hits below each threshold removed, one entry per threshold.
+// thresholds are sorted, so a hit passes exactly the first k of them. it is
+// added once to the sum of interval k, found by a branch free count that
+// vectorizes over the thresholds, and the sum of threshold t is the sum of
+// intervals above t. the collection is read once and every hit costs one
+// add whatever the number of thresholds.
+template<typename Sum>
+ROOT::RVecD
+convertRecEnergyScan(
+  const std::vector<edm4eic::CalorimeterHitData>& event,
+  const std::vector<double>& thresholds)
+{
+  PerfScope perfScope(PerfCounters::kConversion);
+  const size_t nThresholds = thresholds.size();
+  const double* threshold = thresholds.data();
+  ROOT::RVec<Sum> intervalSums(nThresholds + 1);
+
+  for (const auto& hit : event) {
+    const double energy = hit.energy;
+    size_t nPassed = 0;
+    for (size_t t = 0; t < nThresholds; ++t) {
+      nPassed += energy >= threshold[t];
+    }
+    intervalSums[nPassed] += energy;
+  }
+  ROOT::RVecD result(nThresholds);
+  Sum sum{};
+  for (size_t t = nThresholds; t > 0; --t) {
+    sum += intervalSums[t];
+    result[t - 1] = double(sum) * eicrecon_fsam;
+  }
+  return result;
+}
+
+// column of threshold index of the scan, e.g. fsam_T2.
+static std::string
+scanColumn(const std::string& columnName, size_t index)
+{
+  return fmt::format("{}_T{}", columnName, index);
+}
+
+// visible energy corrected by the measured fsam at the energy and eta of the
+// shower. eta is taken from the energy weighted centroid of the hits.
+template<typename Sum>
+double
+convertCorrEnergy(
+  const std::vector<edm4eic::CalorimeterHitData>& event,
+  const FsamTable& fsamTable)
+{
+  PerfScope perfScope(PerfCounters::kConversion);
+  Sum energySum{};
+  Sum xSum{};
+  Sum ySum{};
+  Sum zSum{};
+  for (const auto& hit : event) {
+    energySum += hit.energy;
+    xSum += hit.energy * hit.position.x;
+    ySum += hit.energy * hit.position.y;
+    zSum += hit.energy * hit.position.z;
+  }
+  double sum = double(energySum);
+  if (sum <= 0.0) {
+    return 0.0;
+  }
+  // hit energies are already scaled by 1 / eicrecon_fsam, so their sum
+  // estimates the shower energy the table is binned in.
+  double eta = std::asinh(double(zSum) / std::hypot(double(xSum), double(ySum)));
+  return sum * eicrecon_fsam / fsamTable.lookup(sum, eta);
+};
+
+template<typename Sum>
 double
 convertSimEnergy(const std::vector<edm4hep::SimCalorimeterHitData>& event)
 {
-  double sum = 0.0;
+  PerfScope perfScope(PerfCounters::kConversion);
+  Sum sum{};
   for (const auto& hit : event) {
     sum += hit.energy;
   }
-  return sum;
+  return double(sum);
 };
 
 double
@@ -79,149 +285,263 @@ convertFsam(double recEnergy, double genEnergy)
   return recEnergy / genEnergy;
 };
 
-HistManager::HistManager(const std::string& pathPrefix, bool isSensitive)
+HistManager::HistManager(
+  const std::string& pathPrefix,
+  bool isSensitive,
+  const RunOptions& options)
   : m_pathPrefix(pathPrefix)
+  , m_outputPrefix(options.isPreview ? pathPrefix + "preview/" : pathPrefix)
   , m_isSensitive(isSensitive)
+  , m_options(options)
   , m_energyBins(pathPrefix + "E_range")
   , m_etaBins(pathPrefix + "ETA_range")
 {
-  std::cout << "HistManager constructor begin\n";
+  m_memoryMonitor.beginStage("allocate");
 
+  // a preview is written next to the full results, never over them.
+  if (m_options.isPreview == true) {
+    std::filesystem::create_directories(m_outputPrefix);
+  }
   printBins();
   allocate();
+  if (m_options.fsamTablePath.empty() == false
+      && m_fsamTable.read(m_options.fsamTablePath) == false) {
+    throw std::runtime_error(
+      fmt::format("failed to read fsam table {}.", m_options.fsamTablePath));
+  }
+  if (m_options.selectionPath.empty() == false
+      && m_selection.read(m_options.selectionPath) == false) {
+    throw std::runtime_error(
+      fmt::format("failed to read selection {}.", m_options.selectionPath));
+  }
+  ROOT::EnableThreadSafety();
 
   gStyle->SetOptFit(0);
-  ROOT::EnableThreadSafety();
-  EventHist::s_pathPrefix = m_pathPrefix;
-  std::cout << "HistManager constructor end\n";
+  // threads do not survive a fork; worker processes start their own.
+  if (m_options.nProcesses == 0) {
+    startThreads();
+  }
+  if (m_options.isPerfCounters == true) {
+    PerfCounters::enable();
+  }
+  EventHist::s_pathPrefix = m_outputPrefix;
+  EventHist::s_isReproducible = m_options.isReproducible;
 }
 
 HistManager::~HistManager()
 {
-  delete m_fsam2DHist;
-  delete m_recEnergy2DHist;
-  delete m_simEnergy2DHist;
-  /*
-  for (auto& hist : m_energyHistArr) {
-    delete hist;
+  delete m_file;
+}
+
+void
+HistManager::startThreads()
+{
+  // one task arena of nThreads for every RDataFrame. event loops of running
+  // cells are split into cluster tasks of that arena, so cells never run more
+  // than nThreads threads together, and the tasks of the last cells are
+  // stolen by threads that become idle as other cells finish.
+  if (m_options.nThreads > 0) {
+    ROOT::EnableImplicitMT(m_options.nThreads);
+    Logger::info("implicit MT with {} threads", ROOT::GetThreadPoolSize());
   }
-  for (auto& hist : m_etaHistArr) {
-    delete hist;
+  // the executor joins the arena of implicit MT, so fits count against
+  // nThreads too. without --threads it has an arena of its own.
+  m_executor = std::make_unique<ROOT::TThreadExecutor>(
+    m_options.nThreads > 0 ? m_options.nThreads : ThreadPool::defaultSize());
+  if (m_options.isFitLadder == true) {
+    m_fitLadder = std::make_unique<FitLadder>(*m_executor);
   }
-  */
-  delete m_file;
 }
 
 void
 HistManager::process()
 {
-  std::vector<std::thread> threadVec;
-
-  /*
-  auto work = [this]() {
-    for (size_t energyBin = 0; energyBin < m_energyBins.size(); ++energyBin) {
-      for (size_t etaBin = 0; etaBin < m_etaBins.size(); ++etaBin) {
-        const std::string simInfo = fmt::format(
-          "E{:.2f}_H{:.1f}t{:.1f}",
-          m_energyBins[energyBin],
-          m_etaBins.getLowerBound(etaBin),
-          m_etaBins.getUpperBound(etaBin));
-        ROOT::RDF::RNode dataNode = getDataNode(simInfo);
-        fillHists(simInfo, energyBin, etaBin, dataNode);
+  m_memoryMonitor.beginStage("estimate");
+  std::vector<Cell> cells = makeCells();
+  size_t nWorkers =
+    m_options.nJobs == 0 ? m_energyBins.size() : m_options.nJobs;
+  // cell workers only wait on their event loops, but more of them than
+  // threads would leave every cell with less than one thread.
+  if (m_options.nThreads > 0) {
+    nWorkers = std::min(nWorkers, m_options.nThreads);
+  }
+  if (m_options.nProcesses > 0) {
+    nWorkers = m_options.nProcesses;
+  }
+  size_t nEvents = 0;
+  for (const auto& cell : cells) {
+    nEvents += cell.nEntries;
+  }
+  m_progress = std::make_unique<ProgressMonitor>(
+    m_options.progressPath, cells.size(), nEvents, nWorkers);
+
+  if (m_options.isPreview == true) {
+    m_previewColumns = previewColumns(m_isPreviewScan);
+    m_previews = SharedArray<Preview>(m_results.nCells() * m_previewColumns.size());
+  }
+  if (m_options.isStartupReport == true) {
+    m_jitCounter = std::make_unique<JitCounter>();
+    m_startups.assign(m_energyBins.size() * m_etaBins.size(), CellStartup{});
+  }
+
+  auto runCell = [this](const Cell& cell, size_t worker) {
+    bool isSucceeded = false;
+    LogContext logContext(cell.simInfo, "cell");
+    auto cellStart = std::chrono::steady_clock::now();
+    size_t nJits = JitCounter::threadCount();
+    try {
+      gStyle->SetOptFit(0);
+      ROOT::RDF::RResultPtr<ULong64_t> nRead;
+      ROOT::RDF::RNode dataNode = getDataNode(cell, nRead);
+      ROOT::RDF::RResultPtr<ULong64_t> firstEvent;
+      if (m_options.isStartupReport == true) {
+        firstEvent = watchFirstEvent(cell, cellStart, dataNode);
+      }
+      if (m_options.isPreview == false) {
+        isSucceeded = fillHists(cell, worker, dataNode, nRead);
+      } else if (m_options.isReproducible == true) {
+        isSucceeded = previewCell<ExactSum>(cell, worker, dataNode, nRead);
+      } else {
+        isSucceeded = previewCell<double>(cell, worker, dataNode, nRead);
       }
+    } catch (const std::exception& e) {
+      Logger::error("cell failed: {}", e.what());
     }
-  };
-  work();
-  */
-  auto work = [this](size_t energyBin) {
-    gStyle->SetOptFit(0);
-    ROOT::EnableThreadSafety();
-    std::cout << "thread " << energyBin << " begin\n";
-    for (size_t etaBin = 0; etaBin < m_etaBins.size(); ++etaBin) {
-      const std::string simInfo = fmt::format(
-        "E{:.2f}_H{:.1f}t{:.1f}",
-        m_energyBins[energyBin],
-        m_etaBins.getLowerBound(etaBin),
-        m_etaBins.getUpperBound(etaBin));
-      ROOT::RDF::RNode dataNode = getDataNode(simInfo);
-      fillHists(simInfo, energyBin, etaBin, dataNode);
+    if (m_options.isStartupReport == true) {
+      CellStartup& startup =
+        m_startups[cell.energyBin * m_etaBins.size() + cell.etaBin];
+      startup.simInfo = cell.simInfo;
+      startup.nJits = JitCounter::threadCount() - nJits;
     }
-    std::cout << "thread " << energyBin << " end\n";
+    return isSucceeded;
   };
 
-  std::cout << "starting " << m_energyBins.size() << " threads\n";
-  for (size_t energyBin = 0; energyBin < m_energyBins.size(); ++energyBin) {
-    threadVec.emplace_back(work, energyBin);
-  }
-  for (size_t energyBin = 0; energyBin < m_energyBins.size(); ++energyBin) {
-    threadVec[energyBin].join();
+  m_memoryMonitor.beginStage("process");
+  auto start = std::chrono::steady_clock::now();
+  if (m_options.nProcesses > 0) {
+    // the progress of a worker process is its own copy; cells are counted
+    // here as the supervisor sees them finish.
+    // the samplers must not hold a lock or be writing a file when a
+    // worker is forked.
+    ProcessPool pool(m_options.nProcesses);
+    pool.setForkHooks(
+      [this]() {
+        m_memoryMonitor.pause();
+        m_progress->pause();
+      },
+      [this]() {
+        m_progress->resume();
+        m_memoryMonitor.resume();
+      });
+    pool.run(
+      cells,
+      [this](size_t) { startThreads(); },
+      runCell,
+      [this](const Cell& cell, size_t worker, bool isSucceeded) {
+        m_progress->beginCell();
+        m_progress->addEvents(worker, cell.nEntries);
+        m_progress->endCell(worker, isSucceeded);
+      });
+  } else {
+    CellScheduler scheduler(m_options.memoryBudgetMB * 1048576, nWorkers);
+    scheduler.run(cells, [this, &runCell](const Cell& cell, size_t worker) {
+      m_progress->beginCell();
+      m_progress->endCell(worker, runCell(cell, worker));
+    });
   }
+  m_progress.reset();
+  Logger::info(
+    "{} cells processed in {:.1f} s ({} mode)",
+    cells.size(),
+    std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+      .count(),
+    m_options.isReproducible ? "reproducible" : "fast");
 }
 
 void
 HistManager::storeHists()
 {
+  m_memoryMonitor.beginStage("store");
   if (m_isSensitive == false) {
-    m_fsam2DHist->SetTitle("; Eta; Energy; Sampling fraction");
-    m_fsam2DHist->SaveAs(fmt::format("{}fsam2Dgraph.root", m_pathPrefix).c_str());
-    m_recEnergy2DHist->SetTitle("; Eta; Energy; Sum of reconstructed hits' energy");
-    m_recEnergy2DHist->SaveAs(fmt::format("{}rec2Dgraph.root", m_pathPrefix).c_str());
+    writeGraph("fsam", "Sampling fraction", "fsam2Dgraph.root", true);
+    writeGraph(
+      "recEnergy", "Sum of reconstructed hits' energy", "rec2Dgraph.root", true);
+    writeFsamTable();
+    if (m_options.hitThresholds.empty() == false) {
+      writeThresholdScan();
+    }
+    if (m_fsamTable.isLoaded() == true) {
+      writeGraph(
+        "closure",
+        "Corrected energy / generated energy",
+        "closure2Dgraph.root",
+        true);
+    }
   } else {
-    m_simEnergy2DHist->SetTitle("; Eta; Energy; Calorimeter deposit energy");
-    m_simEnergy2DHist->SaveAs(
-      fmt::format("{}edep2Dgraph.root", m_pathPrefix).c_str());
-  }
-  m_file->cd();
-  for (auto& hist : m_energyHistArr) {
-    hist->Write();
+    writeGraph(
+      "simEnergy", "Calorimeter deposit energy", "edep2Dgraph.root", true);
   }
-  for (auto& hist : m_etaHistArr) {
-    hist->Write();
+  if (m_options.isImaging == true) {
+    for (const auto& [columnName, model] :
+         m_isSensitive ? subsystemSimTable : subsystemRecTable) {
+      std::string title = model.fTitle.Data();
+      title = title.substr(0, title.find(';'));
+      writeGraph(columnName, title, columnName + "2Dgraph.root", false);
+    }
   }
+  writeGridHists();
+  writeBootstrapTrees();
   m_file->Close();
-  std::cout << "result is written to ROOT file.\n";
+  if (m_selection.isEmpty() == false) {
+    writeCutFlows();
+  }
+  fitResolution();
+  Logger::info("result is written to ROOT file");
+  if (m_options.isProfiling == true) {
+    writeProfiles();
+  }
+  if (m_options.exportFormat != ExportTable::kNone) {
+    writeExport();
+  }
+  if (m_options.isStartupReport == true) {
+    writeStartupReport();
+  }
+  if (m_options.targetPrecision > 0.) {
+    writeEarlyStops();
+  }
+  if (m_options.isPreview == true) {
+    writePreviews();
+  }
+  if (PerfCounters::isEnabled() == true) {
+    PerfCounters::write(fmt::format("{}perfCounters.tsv", m_outputPrefix));
+  }
+  m_memoryMonitor.printReport();
 }
 
 void
 HistManager::allocate()
 {
-  m_fsam2DHist = new TGraph2DErrors();
-  m_recEnergy2DHist = new TGraph2DErrors();
-  m_simEnergy2DHist = new TGraph2DErrors();
-  if (m_fsam2DHist == nullptr || m_recEnergy2DHist == nullptr
-      || m_simEnergy2DHist == nullptr) {
-    throw std::runtime_error("failed to allocate TGraph2DErrors.");
+  std::vector<std::string> columns =
+    m_isSensitive ? simResultColumns : recResultColumns;
+  for (size_t i = 0; i < m_options.hitThresholds.size() && !m_isSensitive; ++i) {
+    columns.push_back(scanColumn("recEnergy", i));
+    columns.push_back(scanColumn("fsam", i));
+  }
+  m_results = ResultMatrix(m_energyBins.size(), m_etaBins.size(), columns);
+  m_cellFits = SharedArray<CellFit>(m_results.nCells());
+  if (m_options.targetPrecision > 0.) {
+    m_earlyStops.resize(m_results.nCells());
   }
-  std::cout << "TGraph2DErrors instances allocated\n";
 
+  // opened here so a run never overwrites an earlier result.
   m_file =
-    new TFile(fmt::format("{}1DHists.root", m_pathPrefix).c_str(), "CREATE");
+    new TFile(fmt::format("{}1DHists.root", m_outputPrefix).c_str(), "CREATE");
   if (m_file == nullptr) {
     throw std::runtime_error("failed to create ROOT file.");
   }
   if (m_file->IsOpen() == kFALSE) {
     throw std::runtime_error("failed to open ROOT file.");
   }
-  std::cout << "TFile instance allocated\n";
-
-  for (size_t i = 0; i < m_energyBins.size(); ++i) {
-    std::string histName = fmt::format("E{}", m_energyBins[i]);
-    TH1D* hist = new TH1D(
-      histName.c_str(),
-      histName.c_str(),
-      m_etaBins.size(),
-      m_etaBins.getBinEdges());
-    m_energyHistArr.push_back(hist);
-  }
-  for (size_t i = 0; i < m_etaBins.size(); ++i) {
-    std::string histName = fmt::format("eta{}", m_etaBins.getMiddleValue(i));
-    TH1D* hist = new TH1D(
-      histName.c_str(),
-      histName.c_str(),
-      m_energyBins.size(),
-      m_energyBins.getBinEdges());
-    m_etaHistArr.push_back(hist);
-  }
 }
 
 void
@@ -233,26 +553,182 @@ HistManager::printBins()
   m_energyBins.printBinEdges();
 }
 
+// simInfo of a cell, e.g. E1.00_H0.0t0.1.
+std::string
+HistManager::cellName(size_t energyBin, size_t etaBin) const
+{
+  return fmt::format(
+    "E{:.2f}_H{:.1f}t{:.1f}",
+    m_energyBins[energyBin],
+    m_etaBins.getLowerBound(etaBin),
+    m_etaBins.getUpperBound(etaBin));
+}
+
+// cells of the grid found in the input catalog, with memory estimates from
+// their files, largest first so the long cells start early.
+std::vector<Cell>
+HistManager::makeCells() const
+{
+  std::vector<Cell> cells;
+  std::vector<std::string> branchNames{ "GeneratedParticles",
+                                        "EcalBarrelScFiRecHits" };
+
+  if (m_isSensitive == true) {
+    branchNames.push_back("EcalBarrelScFiHits");
+  }
+  if (m_options.isImaging == true) {
+    branchNames.push_back(
+      m_isSensitive ? "EcalBarrelImagingHits" : "EcalBarrelImagingRecHits");
+  }
+
+  // files are found by the values in their names, whatever their format.
+  InputCatalog catalog;
+  std::string inputDirectory = fmt::format("{}/rec", m_pathPrefix);
+  if (catalog.scan(inputDirectory) == false) {
+    throw std::runtime_error(
+      fmt::format("failed to list input directory {}.", inputDirectory));
+  }
+  std::vector<std::string> missing;
+  for (size_t energyBin = 0; energyBin < m_energyBins.size(); ++energyBin) {
+    for (size_t etaBin = 0; etaBin < m_etaBins.size(); ++etaBin) {
+      Cell cell;
+      cell.energyBin = energyBin;
+      cell.etaBin = etaBin;
+      cell.simInfo = cellName(energyBin, etaBin);
+      const CatalogFile* file = catalog.take(
+        m_energyBins[energyBin],
+        m_etaBins.getLowerBound(etaBin),
+        m_etaBins.getUpperBound(etaBin));
+      if (file == nullptr) {
+        missing.push_back(cell.simInfo);
+        continue;
+      }
+      cell.inputPath = file->path;
+      CellScheduler::estimateMemory(cell, branchNames);
+      Logger::debug(
+        "{}: {}, {:.1f} MB, {} entries",
+        cell.simInfo,
+        cell.inputPath,
+        cell.fileSize / 1048576.,
+        cell.nEntries);
+      cells.push_back(cell);
+    }
+  }
+
+  size_t totalSize = 0;
+  size_t nEntries = 0;
+  for (const auto& cell : cells) {
+    totalSize += cell.fileSize;
+    nEntries += cell.nEntries;
+  }
+  Logger::info(
+    "{} of {} cells found in {}: {:.1f} MB, {} entries",
+    cells.size(),
+    m_energyBins.size() * m_etaBins.size(),
+    inputDirectory,
+    totalSize / 1048576.,
+    nEntries);
+  for (const auto& simInfo : missing) {
+    Logger::warning("missing cell {}", simInfo);
+  }
+  for (const CatalogFile* file : catalog.unused()) {
+    Logger::warning("file of no cell of the grid: {}", file->path);
+  }
+
+  CellScheduler::sortLargestFirst(cells);
+  return cells;
+}
+
 // get data nodes from ROOT file which has reconstructed results.
 ROOT::RDF::RNode
-HistManager::getDataNode(const std::string& simInfo)
+HistManager::getDataNode(
+  const Cell& cell,
+  ROOT::RDF::RResultPtr<ULong64_t>& nRead)
 {
-  const TString inputName =
-    fmt::format("{}/rec/rec_{}.root", m_pathPrefix, simInfo);
+  PerfScope perfScope(PerfCounters::kOpen);
 
   // open a ROOT file containing simulated and reconstructed hits created by
   // eicrecon and get data frame.
-  ROOT::RDataFrame dataFrame("events", inputName);
+  ROOT::RDataFrame dataFrame("events", cell.inputPath);
+  ROOT::RDF::RNode rootNode(dataFrame);
+  nRead = rootNode.Count();
+
+  // closed by the EarlyStopHelper of fillHists() once the cell is precise
+  // enough. columns are read lazily, so rejected events cost no I/O.
+  if (m_options.targetPrecision > 0.) {
+    CellEarlyStop& earlyStop =
+      m_earlyStops[cell.energyBin * m_etaBins.size() + cell.etaBin];
+    auto isStopped = std::make_shared<std::atomic<bool>>(false);
+    earlyStop.simInfo = cell.simInfo;
+    earlyStop.nEntries = cell.nEntries;
+    earlyStop.isStopped = isStopped;
+    rootNode = rootNode.Filter([isStopped]() {
+      return isStopped->load(std::memory_order_relaxed) == false;
+    });
+  }
 
+  // selection first, so the conversions below run only for passing events.
+  auto dataNode = m_selection.apply(rootNode, m_isSensitive);
+
+  if (m_options.isReproducible == true) {
+    return defineColumns<ExactSum>(dataNode);
+  }
+  return defineColumns<double>(dataNode);
+}
+
+template<typename Sum>
+ROOT::RDF::RNode
+HistManager::defineColumns(ROOT::RDF::RNode dataNode)
+{
   // create new data node for generated energy,
-  auto dataNode = ROOT::RDF::RNode(
-    dataFrame.Define("genEnergy", convertGenEnergy, { "GeneratedParticles" }));
+  dataNode =
+    dataNode.Define("genEnergy", convertGenEnergy<Sum>, { "GeneratedParticles" });
 
   // reconstructed energy and sampling fraction.
   dataNode =
-    dataNode.Define("recEnergy", convertRecEnergy, { "EcalBarrelScFiRecHits" })
+    dataNode.Define("recEnergy", convertRecEnergy<Sum>, { "EcalBarrelScFiRecHits" })
       .Define("fsam", convertFsam, { "recEnergy", "genEnergy" });
 
+  // recEnergy and fsam of every hit threshold from one pass over the hits.
+  if (m_options.hitThresholds.empty() == false && m_isSensitive == false) {
+    const std::vector<double> thresholds = m_options.hitThresholds;
+    dataNode = dataNode.Define(
+      "recEnergyScan",
+      [thresholds](const std::vector<edm4eic::CalorimeterHitData>& event) {
+        return convertRecEnergyScan<Sum>(event, thresholds);
+      },
+      { "EcalBarrelScFiRecHits" });
+    for (size_t i = 0; i < thresholds.size(); ++i) {
+      dataNode =
+        dataNode
+          .Define(
+            scanColumn("recEnergy", i),
+            [i](const ROOT::RVecD& scan) { return scan[i]; },
+            { "recEnergyScan" })
+          .Define(
+            scanColumn("fsam", i),
+            [i](const ROOT::RVecD& scan, double genEnergy) {
+              return convertFsam(scan[i], genEnergy);
+            },
+            { "recEnergyScan", "genEnergy" });
+    }
+  }
+
+  // energy corrected by the measured table over generated energy.
+  // the closure is 1 where the table describes the cell.
+  if (m_fsamTable.isLoaded() == true) {
+    const FsamTable* fsamTable = &m_fsamTable;
+    dataNode =
+      dataNode
+        .Define(
+          "corrEnergy",
+          [fsamTable](const std::vector<edm4eic::CalorimeterHitData>& event) {
+            return convertCorrEnergy<Sum>(event, *fsamTable);
+          },
+          { "EcalBarrelScFiRecHits" })
+        .Define("closure", convertFsam, { "corrEnergy", "genEnergy" });
+  }
+
   // if 'EcalBarrelScFiHits' exists in the data frame,
   // it means that the ROOT file should have been generated from a simulation
   // where entire detector is sensitive detector
@@ -260,20 +736,75 @@ HistManager::getDataNode(const std::string& simInfo)
   // deposit.
   if (m_isSensitive == true) {
     dataNode =
-      dataNode.Define("simEnergy", convertSimEnergy, { "EcalBarrelScFiHits" });
+      dataNode.Define("simEnergy", convertSimEnergy<Sum>, { "EcalBarrelScFiHits" });
+  }
+
+  // Imaging layers and the whole barrel, read in the same event loop.
+  if (m_options.isImaging == true && m_isSensitive == false) {
+    dataNode =
+      dataNode
+        .Define(
+          "recEnergyImaging",
+          convertImagingRecEnergy<Sum>,
+          { "EcalBarrelImagingRecHits" })
+        .Define("fsamImaging", convertFsam, { "recEnergyImaging", "genEnergy" })
+        .Define(
+          "recEnergyTotal", convertTotalEnergy, { "recEnergy", "recEnergyImaging" })
+        .Define("fsamTotal", convertFsam, { "recEnergyTotal", "genEnergy" });
+  } else if (m_options.isImaging == true) {
+    dataNode =
+      dataNode
+        .Define(
+          "simEnergyImaging", convertSimEnergy<Sum>, { "EcalBarrelImagingHits" })
+        .Define(
+          "simEnergyTotal", convertTotalEnergy, { "simEnergy", "simEnergyImaging" });
   }
-  std::cout << "getDataNode end\n";
   return dataNode;
 }
 
-void
+// returns false if any fit of the cell failed.
+bool
 HistManager::fillHists(
-  const std::string& simInfo,
-  size_t energyBin,
-  size_t etaBin,
-  ROOT::RDF::RNode& dataNode)
+  const Cell& cell,
+  size_t worker,
+  ROOT::RDF::RNode& dataNode,
+  ROOT::RDF::RResultPtr<ULong64_t>& nRead)
 {
-  static std::mutex histMutex;
+  const std::string& simInfo = cell.simInfo;
+  const size_t energyBin = cell.energyBin;
+  const size_t etaBin = cell.etaBin;
+  bool isSucceeded = true;
+
+  // events are reported from every slot in steps during the first event
+  // loop; the remainder is added when the cell is done.
+  ProgressMonitor* progress = m_progress.get();
+  auto reported = std::make_shared<std::atomic<size_t>>(0);
+  nRead.OnPartialResultSlot(
+    progressStep, [progress, worker, reported](unsigned int, ULong64_t&) {
+      *reported += progressStep;
+      progress->addEvents(worker, progressStep);
+    });
+  ROOT::RDF::RResultPtr<ROOT::RDF::RCutFlowReport> cutFlow;
+  if (m_selection.isEmpty() == false) {
+    cutFlow = dataNode.Report();
+  }
+
+  // running precision of the watched column for --target-precision.
+  ROOT::RDF::RResultPtr<EarlyStop> earlyStop;
+  if (m_options.targetPrecision > 0.) {
+    earlyStop = dataNode.Book<double>(
+      EarlyStopHelper(
+        m_options.targetPrecision,
+        m_earlyStops[energyBin * m_etaBins.size() + etaBin].isStopped,
+        dataNode.GetNSlots()),
+      { m_isSensitive ? "simEnergy" : "fsam" });
+  }
+
+  // booked before the first fit so the profile fills in the same event loop.
+  ROOT::RDF::RResultPtr<ShowerProfile> profile;
+  if (m_options.isProfiling == true) {
+    profile = bookProfile(dataNode);
+  }
   // we have a data node which contains columns
   // for reconstructed energy, sampling fraction and optional simulated
   // energy. histograms will be generated from the columns.
@@ -283,59 +814,860 @@ HistManager::fillHists(
   // Data column for fitting is determined when it is initialized.
   // two: draw histogram to image file. not implemented yet.
   // EventHist recEHist(histTable[0].first, histTable[0].second, simInfo);
+  // every histogram of the cell is booked before the first fit, so the file
+  // is read in a single event loop.
+
+  // per event values of --export-events.
+  std::vector<ROOT::RDF::RResultPtr<std::vector<double>>> eventValues;
+  if (m_options.isExportingEvents == true) {
+    for (const auto& column : eventColumns()) {
+      eventValues.push_back(dataNode.Take<double>(column));
+    }
+  }
+
+  // Imaging and total columns of --imaging.
+  const auto& subsystemTable =
+    m_isSensitive ? subsystemSimTable : subsystemRecTable;
+  std::vector<std::unique_ptr<EventHist>> subsystemHists;
+  if (m_options.isImaging == true) {
+    for (const auto& [columnName, model] : subsystemTable) {
+      subsystemHists.push_back(
+        std::make_unique<EventHist>(columnName, model, simInfo));
+      subsystemHists.back()->setFitLadder(m_fitLadder.get());
+      subsystemHists.back()->book(dataNode);
+    }
+  }
 
   if (m_isSensitive == false) {
     EventHist recEHist(histTable[0].first, histTable[0].second, simInfo);
     EventHist fsamHist(histTable[1].first, histTable[1].second, simInfo);
+    recEHist.setBootstrap(m_options.nBootstrap, m_executor.get());
+    fsamHist.setBootstrap(m_options.nBootstrap, m_executor.get());
+    recEHist.setFitLadder(m_fitLadder.get());
+    fsamHist.setFitLadder(m_fitLadder.get());
+    recEHist.book(dataNode);
+    fsamHist.book(dataNode);
+    std::unique_ptr<EventHist> closureHist;
+    if (m_fsamTable.isLoaded() == true) {
+      closureHist = std::make_unique<EventHist>(
+        histTable[3].first, histTable[3].second, simInfo);
+      closureHist->setFitLadder(m_fitLadder.get());
+      closureHist->book(dataNode);
+    }
+    const size_t nThresholds = m_options.hitThresholds.size();
+    std::vector<std::unique_ptr<EventHist>> scanHists;
+    for (size_t i = 0; i < nThresholds; ++i) {
+      for (size_t k = 0; k < 2; ++k) {
+        std::string column = scanColumn(histTable[k].first, i);
+        scanHists.push_back(
+          std::make_unique<EventHist>(column, histTable[k].second, simInfo));
+        scanHists.back()->setFitLadder(m_fitLadder.get());
+        scanHists.back()->book(dataNode);
+      }
+    }
     auto fsamMean = fsamHist.getGausFitMean(dataNode, true);
     auto recEMean = recEHist.getGausFitMean(dataNode, true);
+    isSucceeded = fsamMean.first > 0 && recEMean.first > 0;
 
+    m_results.set("recEnergy", energyBin, etaBin, recEMean);
+    m_results.set("fsam", energyBin, etaBin, fsamMean);
+    m_cellFits[energyBin * m_etaBins.size() + etaBin] =
+      CellFit{ recEMean.first,
+               recEMean.second,
+               recEHist.getGausFitSigma().first,
+               recEHist.getGausFitSigma().second };
     histMutex.lock();
-    m_energyHistArr[energyBin]->SetBinContent(etaBin + 1, recEMean.first);
-    m_energyHistArr[energyBin]->SetBinError(etaBin + 1, recEMean.second);
-    m_etaHistArr[etaBin]->SetBinContent(energyBin + 1, recEMean.first);
-    m_etaHistArr[etaBin]->SetBinError(energyBin + 1, recEMean.second);
-    m_fsam2DHist->SetPoint(
-      energyBin * m_etaBins.size() + etaBin,
-      m_etaBins.getMiddleValue(etaBin),
-      m_energyBins[energyBin],
-      fsamMean.first);
-    m_fsam2DHist->SetPointError(
-      energyBin * m_etaBins.size() + etaBin,
-      m_etaBins.getMiddleValue(etaBin),
-      m_energyBins[energyBin],
-      fsamMean.second);
-    m_recEnergy2DHist->SetPoint(
-      energyBin * m_etaBins.size() + etaBin,
-      m_etaBins.getMiddleValue(etaBin),
-      m_energyBins[energyBin],
-      recEMean.first);
-    m_recEnergy2DHist->SetPointError(
-      energyBin * m_etaBins.size() + etaBin,
-      m_etaBins.getMiddleValue(etaBin),
-      m_energyBins[energyBin],
-      recEMean.second);
+    addBootstrap(cell, recEHist);
+    addBootstrap(cell, fsamHist);
     histMutex.unlock();
+    for (size_t i = 0; i < nThresholds; ++i) {
+      m_results.set(
+        scanColumn("recEnergy", i),
+        energyBin,
+        etaBin,
+        scanHists[2 * i]->getGausFitMean(dataNode, false));
+      m_results.set(
+        scanColumn("fsam", i),
+        energyBin,
+        etaBin,
+        scanHists[2 * i + 1]->getGausFitMean(dataNode, false));
+    }
+    if (m_fsamTable.isLoaded() == true) {
+      auto closureMean = closureHist->getGausFitMean(dataNode, true);
+      isSucceeded = isSucceeded && closureMean.first > 0;
+      m_results.set("closure", energyBin, etaBin, closureMean);
+    }
   } else {
     EventHist simEHist(histTable[2].first, histTable[2].second, simInfo);
+    simEHist.setBootstrap(m_options.nBootstrap, m_executor.get());
+    simEHist.setFitLadder(m_fitLadder.get());
     auto simEMean = simEHist.getGausFitMean(dataNode, true);
+    isSucceeded = simEMean.first > 0;
 
+    m_results.set("simEnergy", energyBin, etaBin, simEMean);
+    m_cellFits[energyBin * m_etaBins.size() + etaBin] =
+      CellFit{ simEMean.first,
+               simEMean.second,
+               simEHist.getGausFitSigma().first,
+               simEHist.getGausFitSigma().second };
     histMutex.lock();
-    m_energyHistArr[energyBin]->SetBinContent(etaBin + 1, simEMean.first);
-    m_energyHistArr[energyBin]->SetBinError(etaBin + 1, simEMean.second);
-    m_etaHistArr[etaBin]->SetBinContent(energyBin + 1, simEMean.first);
-    m_etaHistArr[etaBin]->SetBinError(energyBin + 1, simEMean.second);
-    m_simEnergy2DHist->SetPoint(
-      energyBin * m_etaBins.size() + etaBin,
-      m_etaBins.getMiddleValue(etaBin),
-      m_energyBins[energyBin],
-      simEMean.first);
-    m_simEnergy2DHist->SetPointError(
-      energyBin * m_etaBins.size() + etaBin,
-      m_etaBins.getMiddleValue(etaBin),
-      m_energyBins[energyBin],
-      simEMean.second);
+    addBootstrap(cell, simEHist);
     histMutex.unlock();
   }
-  std::cout << "fillHists end\n";
+  for (size_t i = 0; i < subsystemHists.size(); ++i) {
+    auto mean = subsystemHists[i]->getGausFitMean(dataNode, true);
+    isSucceeded = isSucceeded && mean.first > 0;
+    m_results.set(subsystemTable[i].first, energyBin, etaBin, mean);
+  }
+  if (m_options.isExportingEvents == true) {
+    EventRows rows{ energyBin, etaBin, {} };
+    for (auto& values : eventValues) {
+      rows.columns.push_back(std::move(*values));
+    }
+    histMutex.lock();
+    m_eventRows.push_back(std::move(rows));
+    histMutex.unlock();
+  }
+  if (m_options.targetPrecision > 0.) {
+    const EarlyStop& result = *earlyStop;
+    m_earlyStops[energyBin * m_etaBins.size() + etaBin].result = result;
+    Logger::info(
+      "{} of {} events used, relative error {:.2e}{}",
+      result.nEvents,
+      cell.nEntries,
+      result.relError,
+      result.isStopped ? ", stopped early" : "");
+  }
+  if (m_options.isProfiling == true) {
+    histMutex.lock();
+    m_profiles.push_back(
+      ProfileRow{ cell.energyBin, cell.etaBin, cell.simInfo, *profile });
+    histMutex.unlock();
+  }
+  if (m_selection.isEmpty() == false) {
+    addCutFlow(cell, cutFlow);
+  }
+  progress->addEvents(worker, *nRead - *reported);
+  return isSucceeded;
+}
+
+// columns fitted by fillHists(), the main energy column first. isScan
+// marks the columns of the threshold scan.
+std::vector<std::string>
+HistManager::previewColumns(std::vector<bool>& isScan) const
+{
+  std::vector<std::string> columns;
+
+  if (m_isSensitive == false) {
+    columns = { "recEnergy", "fsam" };
+    if (m_fsamTable.isLoaded() == true) {
+      columns.push_back("closure");
+    }
+    isScan.assign(columns.size(), false);
+    for (size_t i = 0; i < m_options.hitThresholds.size(); ++i) {
+      columns.push_back(scanColumn("recEnergy", i));
+      columns.push_back(scanColumn("fsam", i));
+      isScan.insert(isScan.end(), 2, true);
+    }
+  } else {
+    columns = { "simEnergy" };
+    isScan.assign(columns.size(), false);
+  }
+  if (m_options.isImaging == true) {
+    for (const auto& [columnName, model] :
+         m_isSensitive ? subsystemSimTable : subsystemRecTable) {
+      columns.push_back(columnName);
+      isScan.push_back(false);
+    }
+  }
+  return columns;
+}
+
+// --preview: the estimators of Preview.hpp for the columns fillHists() fits,
+// from one event loop without histograms, fits or drawing. the truncated
+// mean and its error stand in for the fitted mean, so graphs, histograms and
+// tables keep the layout of the full mode.
+template<typename Sum>
+bool
+HistManager::previewCell(
+  const Cell& cell,
+  size_t worker,
+  ROOT::RDF::RNode& dataNode,
+  ROOT::RDF::RResultPtr<ULong64_t>& nRead)
+{
+  const size_t nColumns = m_previewColumns.size();
+  const size_t cellIndex = cell.energyBin * m_etaBins.size() + cell.etaBin;
+  bool isSucceeded = true;
+
+  ROOT::RDF::RResultPtr<ROOT::RDF::RCutFlowReport> cutFlow;
+  if (m_selection.isEmpty() == false) {
+    cutFlow = dataNode.Report();
+  }
+  std::vector<ROOT::RDF::RResultPtr<Preview>> previews;
+  for (const auto& column : m_previewColumns) {
+    previews.push_back(dataNode.Book<double>(
+      PreviewHelper<Sum>(dataNode.GetNSlots()), { column }));
+  }
+  // dereferencing runs the event loop for every booked action.
+  ULong64_t nEvents = 0;
+  {
+    PerfScope perfScope(PerfCounters::kEventLoop);
+    nEvents = *nRead;
+  }
+
+  for (size_t i = 0; i < nColumns; ++i) {
+    const Preview& preview = *previews[i];
+    const std::string& column = m_previewColumns[i];
+    std::pair<double, double> mean{ preview.truncatedMean,
+                                    preview.truncatedMeanError };
+    if (!(mean.first > 0.)) {
+      Logger::warning("{} has no positive truncated mean", column);
+      mean = { 0., 0. };
+      // like in fillHists(), columns of the threshold scan never fail a cell.
+      isSucceeded = isSucceeded && m_isPreviewScan[i];
+    }
+    m_results.set(column, cell.energyBin, cell.etaBin, mean);
+    m_previews[cellIndex * nColumns + i] = preview;
+    Logger::debug(
+      "{}: {} events, mean {:.5g}, median {:.5g}, truncated mean {:.5g} +- "
+      "{:.2g}, std dev {:.3g}",
+      column,
+      preview.nEvents,
+      preview.mean,
+      preview.median,
+      preview.truncatedMean,
+      preview.truncatedMeanError,
+      preview.stdDev);
+  }
+  const Preview& energy = *previews.front();
+  if (energy.nEvents > 0) {
+    m_cellFits[cellIndex] =
+      CellFit{ energy.truncatedMean,
+               energy.truncatedMeanError,
+               energy.sigma,
+               energy.sigma / std::sqrt(2. * energy.nEvents) };
+  }
+  if (m_selection.isEmpty() == false) {
+    addCutFlow(cell, cutFlow);
+  }
+  m_progress->addEvents(worker, nEvents);
+  return isSucceeded;
+}
+
+void
+HistManager::addCutFlow(
+  const Cell& cell,
+  ROOT::RDF::RResultPtr<ROOT::RDF::RCutFlowReport>& cutFlow)
+{
+  std::vector<CutFlowRow> rows;
+
+  for (const auto& cut : *cutFlow) {
+    rows.push_back(CutFlowRow{ cut.GetName(), cut.GetAll(), cut.GetPass() });
+    Logger::info(
+      "cut {}: {} of {} pass ({:.1f}%)",
+      cut.GetName(),
+      cut.GetPass(),
+      cut.GetAll(),
+      cut.GetEff());
+  }
+  histMutex.lock();
+  m_cutFlows.push_back(
+    CutFlow{ cell.energyBin, cell.etaBin, cell.simInfo, std::move(rows) });
+  histMutex.unlock();
+}
+
+// caller holds histMutex.
+void
+HistManager::addBootstrap(const Cell& cell, const EventHist& eventHist)
+{
+  if (m_options.nBootstrap == 0) {
+    return;
+  }
+  m_bootstrapRows[eventHist.getColumnName()].push_back(
+    BootstrapRow{ cell.energyBin, cell.etaBin, eventHist.getBootstrap() });
+}
+
+// one tree 'bootstrap_COLUMN' per column with a row per cell.
+// getFsam pairs the replicas of rec and edep trees to get the ratio interval.
+void
+HistManager::writeBootstrapTrees()
+{
+  // rows arrive in completion order; write them in grid order.
+  for (auto& [columnName, rows] : m_bootstrapRows) {
+    std::sort(rows.begin(), rows.end(), [](const auto& a, const auto& b) {
+      return std::make_pair(a.energyBin, a.etaBin)
+             < std::make_pair(b.energyBin, b.etaBin);
+    });
+  }
+  for (const auto& [columnName, rows] : m_bootstrapRows) {
+    TTree tree(
+      fmt::format("bootstrap_{}", columnName).c_str(),
+      fmt::format("bootstrap replicas of {}", columnName).c_str());
+    int energyBin;
+    int etaBin;
+    double mean;
+    double stdDev;
+    double lower;
+    double upper;
+    std::vector<double> replicas;
+
+    tree.Branch("energyBin", &energyBin);
+    tree.Branch("etaBin", &etaBin);
+    tree.Branch("mean", &mean);
+    tree.Branch("stdDev", &stdDev);
+    tree.Branch("lower", &lower);
+    tree.Branch("upper", &upper);
+    tree.Branch("replicas", &replicas);
+    for (const auto& row : rows) {
+      energyBin = row.energyBin;
+      etaBin = row.etaBin;
+      mean = row.result.mean;
+      stdDev = row.result.stdDev;
+      lower = row.result.lower;
+      upper = row.result.upper;
+      replicas = row.result.replicas;
+      tree.Fill();
+    }
+    tree.Write();
+  }
+}
+
+// rec hits are scaled back to visible energy like convertRecEnergy.
+ROOT::RDF::RResultPtr<ShowerProfile>
+HistManager::bookProfile(ROOT::RDF::RNode& dataNode)
+{
+  if (m_options.isReproducible == true) {
+    return bookProfileWith<ExactSum>(dataNode);
+  }
+  return bookProfileWith<double>(dataNode);
+}
+
+template<typename Sum>
+ROOT::RDF::RResultPtr<ShowerProfile>
+HistManager::bookProfileWith(ROOT::RDF::RNode& dataNode)
+{
+  if (m_isSensitive == false) {
+    using Hit = edm4eic::CalorimeterHitData;
+    return dataNode.Book<std::vector<Hit>>(
+      ShowerProfileHelper<Hit, Sum>(
+        m_options.profileBinning, eicrecon_fsam, dataNode.GetNSlots()),
+      { "EcalBarrelScFiRecHits" });
+  }
+  using Hit = edm4hep::SimCalorimeterHitData;
+  return dataNode.Book<std::vector<Hit>>(
+    ShowerProfileHelper<Hit, Sum>(
+      m_options.profileBinning, 1., dataNode.GetNSlots()),
+    { "EcalBarrelScFiHits" });
+}
+
+// mean energy per event in every layer and radial bin of each cell.
+// getFsam divides rec and edep profiles into per layer sampling fractions.
+void
+HistManager::writeProfiles()
+{
+  const ProfileBinning& binning = m_options.profileBinning;
+  std::string path = fmt::format("{}profiles.root", m_outputPrefix);
+  TFile* file = TFile::Open(path.c_str(), "CREATE");
+
+  if (file == nullptr || file->IsOpen() == kFALSE) {
+    Logger::error("cannot open file {}", path);
+    delete file;
+    return;
+  }
+  // rows arrive in completion order; write them in grid order.
+  std::sort(m_profiles.begin(), m_profiles.end(), [](const auto& a, const auto& b) {
+    return std::make_pair(a.energyBin, a.etaBin)
+           < std::make_pair(b.energyBin, b.etaBin);
+  });
+  for (const auto& [energyBin, etaBin, simInfo, profile] : m_profiles) {
+    double scale = profile.nEvents > 0. ? 1. / profile.nEvents : 0.;
+    TH1D layerHist(
+      fmt::format("layer_{}", simInfo).c_str(),
+      "; Layer; Energy per event [GeV]",
+      binning.nLayers(),
+      0.,
+      binning.nLayers());
+    TH1D radialHist(
+      fmt::format("radial_{}", simInfo).c_str(),
+      "; Radial depth [mm]; Energy per event [GeV]",
+      binning.nRadialBins,
+      binning.radialMin,
+      binning.radialMax);
+
+    for (size_t i = 0; i < profile.layerSum.size(); ++i) {
+      layerHist.SetBinContent(i + 1, profile.layerSum[i] * scale);
+    }
+    for (size_t i = 0; i < profile.radialSum.size(); ++i) {
+      radialHist.SetBinContent(i + 1, profile.radialSum[i] * scale);
+    }
+    layerHist.Write();
+    radialHist.Write();
+  }
+  file->Close();
+  delete file;
+  Logger::info("profiles are written to {}", path);
+}
+
+// fitted fsam of every cell as fsamTable.bin, the input of --fsam-table.
+// cells without a fit are filled from their neighbours.
+void
+HistManager::writeFsamTable()
+{
+  std::string path = fmt::format("{}fsamTable.bin", m_outputPrefix);
+  std::vector<double> etaCenters(m_etaBins.size());
+  std::vector<double> fsamValues(m_results.nCells(), 0.);
+  std::vector<char> fsamValid(m_results.nCells(), 0);
+
+  for (size_t j = 0; j < m_etaBins.size(); ++j) {
+    etaCenters[j] = m_etaBins.getMiddleValue(j);
+  }
+  for (size_t cell = 0; cell < m_results.nCells(); ++cell) {
+    const auto& fsam = m_results.at("fsam", cell);
+    if (fsam.isSet == true) {
+      fsamValues[cell] = fsam.value;
+      fsamValid[cell] = fsam.value > 0.;
+    }
+  }
+  if (FsamTable::write(
+        path,
+        m_energyBins.getEnergyBins(),
+        etaCenters,
+        fsamValues,
+        fsamValid,
+        m_options.lutInterpolation,
+        m_options.lutExtrapolation,
+        m_options.lutSmooth)
+      == false) {
+    Logger::error("cannot write {}", path);
+    return;
+  }
+  Logger::info("fsam table is written to {}", path);
+}
+
+/*
+ * <fileName> with the column as a TGraph2DErrors, one point per cell at its
+ * grid index. cells that did not finish are (0, 0, 0) below the last
+ * finished cell and missing above it. the ScFi graphs keep eta and energy
+ * as x and y errors (hasGridErrors), the others only have the fit error.
+ */
+void
+HistManager::writeGraph(
+  const std::string& columnName,
+  const std::string& title,
+  const std::string& fileName,
+  bool hasGridErrors)
+{
+  TGraph2DErrors graph;
+
+  for (size_t cell = 0; cell < m_results.nCells(); ++cell) {
+    const auto& entry = m_results.at(columnName, cell);
+    if (entry.isSet == false) {
+      continue;
+    }
+    double eta = m_etaBins.getMiddleValue(cell % m_etaBins.size());
+    double energy = m_energyBins[cell / m_etaBins.size()];
+    graph.SetPoint(cell, eta, energy, entry.value);
+    if (hasGridErrors == true) {
+      graph.SetPointError(cell, eta, energy, entry.error);
+    } else {
+      graph.SetPointError(cell, 0., 0., entry.error);
+    }
+  }
+  graph.SetTitle(fmt::format("; Eta; Energy; {}", title).c_str());
+  graph.SaveAs(fmt::format("{}{}", m_outputPrefix, fileName).c_str());
+}
+
+// 'E' and 'eta' histograms of the energy column into 1DHists.root.
+// created in the file's directory, which owns and deletes them on Close().
+void
+HistManager::writeGridHists()
+{
+  const std::string columnName = m_isSensitive ? "simEnergy" : "recEnergy";
+  std::vector<TH1D*> energyHists;
+  std::vector<TH1D*> etaHists;
+
+  m_file->cd();
+  for (size_t i = 0; i < m_energyBins.size(); ++i) {
+    std::string histName = fmt::format("E{}", m_energyBins[i]);
+    energyHists.push_back(new TH1D(
+      histName.c_str(),
+      histName.c_str(),
+      m_etaBins.size(),
+      m_etaBins.getBinEdges()));
+  }
+  for (size_t i = 0; i < m_etaBins.size(); ++i) {
+    std::string histName = fmt::format("eta{}", m_etaBins.getMiddleValue(i));
+    etaHists.push_back(new TH1D(
+      histName.c_str(),
+      histName.c_str(),
+      m_energyBins.size(),
+      m_energyBins.getBinEdges()));
+  }
+  for (size_t cell = 0; cell < m_results.nCells(); ++cell) {
+    const auto& entry = m_results.at(columnName, cell);
+    if (entry.isSet == false) {
+      continue;
+    }
+    size_t energyBin = cell / m_etaBins.size();
+    size_t etaBin = cell % m_etaBins.size();
+    energyHists[energyBin]->SetBinContent(etaBin + 1, entry.value);
+    energyHists[energyBin]->SetBinError(etaBin + 1, entry.error);
+    etaHists[etaBin]->SetBinContent(energyBin + 1, entry.value);
+    etaHists[etaBin]->SetBinError(energyBin + 1, entry.error);
+  }
+  for (auto& hist : energyHists) {
+    hist->Write();
+  }
+  for (auto& hist : etaHists) {
+    hist->Write();
+  }
+}
+
+// columns of the events export: the base columns of the mode, then the
+// optional groups of the run in this order.
+std::vector<std::string>
+HistManager::eventColumns() const
+{
+  std::vector<std::string> columns{ "genEnergy" };
+
+  if (m_isSensitive == true) {
+    columns.push_back("simEnergy");
+    if (m_options.isImaging == true) {
+      columns.insert(columns.end(), { "simEnergyImaging", "simEnergyTotal" });
+    }
+    return columns;
+  }
+  columns.insert(columns.end(), { "recEnergy", "fsam" });
+  if (m_fsamTable.isLoaded() == true) {
+    columns.insert(columns.end(), { "corrEnergy", "closure" });
+  }
+  if (m_options.isImaging == true) {
+    columns.insert(
+      columns.end(),
+      { "recEnergyImaging", "fsamImaging", "recEnergyTotal", "fsamTotal" });
+  }
+  return columns;
+}
+
+/*
+ * cells.<format>: one row per grid cell in grid order with
+ *   energyBin, etaBin, energy, eta, simInfo,
+ *   <column>, <column>Error for every result column of the mode,
+ *   <rec|sim>EnergySigma, <rec|sim>EnergySigmaError.
+ * events.<format>: energyBin, etaBin and eventColumns() of every event,
+ *   cells in grid order.
+ */
+void
+HistManager::writeExport()
+{
+  const size_t nEta = m_etaBins.size();
+  const size_t nCells = m_energyBins.size() * nEta;
+  std::vector<std::int64_t> energyBins(nCells);
+  std::vector<std::int64_t> etaBins(nCells);
+  std::vector<double> energies(nCells);
+  std::vector<double> etas(nCells);
+  std::vector<std::string> simInfos(nCells);
+
+  for (size_t cell = 0; cell < nCells; ++cell) {
+    energyBins[cell] = cell / nEta;
+    etaBins[cell] = cell % nEta;
+    energies[cell] = m_energyBins[cell / nEta];
+    etas[cell] = m_etaBins.getMiddleValue(cell % nEta);
+    simInfos[cell] = fmt::format(
+      "E{:.2f}_H{:.1f}t{:.1f}",
+      energies[cell],
+      m_etaBins.getLowerBound(cell % nEta),
+      m_etaBins.getUpperBound(cell % nEta));
+  }
+  ExportTable cells(
+    m_isSensitive ? "fsam.cells.sensitive" : "fsam.cells", cellsSchemaVersion);
+  cells.addColumn("energyBin", energyBins);
+  cells.addColumn("etaBin", etaBins);
+  cells.addColumn("energy", energies);
+  cells.addColumn("eta", etas);
+  cells.addColumn("simInfo", simInfos);
+  for (const auto& column : m_isSensitive ? simResultColumns : recResultColumns) {
+    std::vector<double> values(nCells);
+    std::vector<double> errors(nCells);
+    for (size_t cell = 0; cell < nCells; ++cell) {
+      values[cell] = m_results.at(column, cell).value;
+      errors[cell] = m_results.at(column, cell).error;
+    }
+    cells.addColumn(column, std::move(values));
+    cells.addColumn(column + "Error", std::move(errors));
+  }
+  std::vector<double> sigmas(nCells);
+  std::vector<double> sigmaErrors(nCells);
+  for (size_t cell = 0; cell < nCells; ++cell) {
+    sigmas[cell] = m_cellFits[cell].sigma;
+    sigmaErrors[cell] = m_cellFits[cell].sigmaError;
+  }
+  std::string energyColumn = m_isSensitive ? "simEnergy" : "recEnergy";
+  cells.addColumn(energyColumn + "Sigma", std::move(sigmas));
+  cells.addColumn(energyColumn + "SigmaError", std::move(sigmaErrors));
+  cells.write(m_outputPrefix + "cells", m_options.exportFormat);
+
+  if (m_options.isExportingEvents == false) {
+    return;
+  }
+  std::sort(m_eventRows.begin(), m_eventRows.end(), [](const auto& a, const auto& b) {
+    return std::make_pair(a.energyBin, a.etaBin)
+           < std::make_pair(b.energyBin, b.etaBin);
+  });
+  const std::vector<std::string> columnNames = eventColumns();
+  std::vector<std::int64_t> eventEnergyBins;
+  std::vector<std::int64_t> eventEtaBins;
+  std::vector<std::vector<double>> columns(columnNames.size());
+  for (const auto& rows : m_eventRows) {
+    size_t nEvents = rows.columns.empty() ? 0 : rows.columns.front().size();
+    eventEnergyBins.insert(eventEnergyBins.end(), nEvents, rows.energyBin);
+    eventEtaBins.insert(eventEtaBins.end(), nEvents, rows.etaBin);
+    for (size_t k = 0; k < columns.size(); ++k) {
+      columns[k].insert(
+        columns[k].end(), rows.columns[k].begin(), rows.columns[k].end());
+    }
+  }
+  m_eventRows.clear();
+  ExportTable events(
+    m_isSensitive ? "fsam.events.sensitive" : "fsam.events", eventsSchemaVersion);
+  events.addColumn("energyBin", std::move(eventEnergyBins));
+  events.addColumn("etaBin", std::move(eventEtaBins));
+  for (size_t k = 0; k < columns.size(); ++k) {
+    events.addColumn(columnNames[k], std::move(columns[k]));
+  }
+  events.write(m_outputPrefix + "events", m_options.exportFormat);
+}
+
+// recEnergy and fsam graphs of every threshold, T<i> being the i-th entry of
+// --thresholds. failed fits are left out of the graphs.
+void
+HistManager::writeThresholdScan()
+{
+  std::string path = fmt::format("{}thresholdScan.root", m_outputPrefix);
+  TFile* file = TFile::Open(path.c_str(), "CREATE");
+
+  if (file == nullptr || file->IsOpen() == kFALSE) {
+    Logger::error("cannot open file {}", path);
+    delete file;
+    return;
+  }
+  for (size_t i = 0; i < m_options.hitThresholds.size(); ++i) {
+    TGraph2DErrors recGraph;
+    TGraph2DErrors fsamGraph;
+    for (size_t cell = 0; cell < m_results.nCells(); ++cell) {
+      double eta = m_etaBins.getMiddleValue(cell % m_etaBins.size());
+      double energy = m_energyBins[cell / m_etaBins.size()];
+      const auto& rec = m_results.at(scanColumn("recEnergy", i), cell);
+      const auto& fsam = m_results.at(scanColumn("fsam", i), cell);
+      if (rec.isSet == true && rec.value > 0.) {
+        int point = recGraph.GetN();
+        recGraph.SetPoint(point, eta, energy, rec.value);
+        recGraph.SetPointError(point, 0., 0., rec.error);
+      }
+      if (fsam.isSet == true && fsam.value > 0.) {
+        int point = fsamGraph.GetN();
+        fsamGraph.SetPoint(point, eta, energy, fsam.value);
+        fsamGraph.SetPointError(point, 0., 0., fsam.error);
+      }
+    }
+    double threshold = m_options.hitThresholds[i];
+    recGraph.SetTitle(fmt::format(
+                        "hit energy >= {} GeV; Eta; Energy; "
+                        "Sum of reconstructed hits' energy",
+                        threshold)
+                        .c_str());
+    fsamGraph.SetTitle(
+      fmt::format("hit energy >= {} GeV; Eta; Energy; Sampling fraction", threshold)
+        .c_str());
+    recGraph.Write(scanColumn("rec2Dgraph", i).c_str());
+    fsamGraph.Write(scanColumn("fsam2Dgraph", i).c_str());
+  }
+  file->Close();
+  delete file;
+  Logger::info("threshold scan is written to {}", path);
+}
+
+// the first partial result of a count marks the first event of the cell
+// reaching the histograms: the file is open, the graph is built and
+// jitted, if anything had to be.
+ROOT::RDF::RResultPtr<ULong64_t>
+HistManager::watchFirstEvent(
+  const Cell& cell,
+  std::chrono::steady_clock::time_point start,
+  ROOT::RDF::RNode& dataNode)
+{
+  CellStartup* startup =
+    &m_startups[cell.energyBin * m_etaBins.size() + cell.etaBin];
+  auto count = dataNode.Count();
+
+  count.OnPartialResult(count.kOnce, [startup, start](ULong64_t&) {
+    startup->timeToFirstEvent =
+      std::chrono::duration<double>(std::chrono::steady_clock::now() - start)
+        .count();
+  });
+  return count;
+}
+
+// one row per cell: simInfo, ms to the first event, JIT compilations.
+// cells without events have no time.
+void
+HistManager::writeStartupReport()
+{
+  std::string path = fmt::format("{}startup.tsv", m_outputPrefix);
+  std::ofstream ofs(path);
+  std::vector<double> times;
+
+  if (!ofs) {
+    Logger::error("cannot open file {}", path);
+    return;
+  }
+  ofs << "simInfo\ttimeToFirstEvent_ms\tjits\n";
+  for (const auto& startup : m_startups) {
+    if (startup.simInfo.empty() == true) {
+      continue;
+    }
+    if (startup.timeToFirstEvent >= 0.) {
+      times.push_back(startup.timeToFirstEvent * 1e3);
+    }
+    ofs << fmt::format(
+      "{}\t{}\t{}\n",
+      startup.simInfo,
+      startup.timeToFirstEvent >= 0.
+        ? fmt::format("{:.1f}", startup.timeToFirstEvent * 1e3)
+        : "-",
+      startup.nJits);
+  }
+  std::sort(times.begin(), times.end());
+  Logger::info(
+    "time to first event: median {:.1f} ms, max {:.1f} ms over {} cells, {} "
+    "JIT compilations",
+    times.empty() ? 0. : times[times.size() / 2],
+    times.empty() ? 0. : times.back(),
+    times.size(),
+    JitCounter::total());
+  Logger::info("startup report is written to {}", path);
+}
+
+// one row per cell: simInfo, entries of the file, events used after the
+// selection, relative error on the mean of the watched column, 1 if the
+// cell stopped before the end of its file.
+void
+HistManager::writeEarlyStops()
+{
+  std::string path = fmt::format("{}earlyStop.tsv", m_outputPrefix);
+  std::ofstream ofs(path);
+  ULong64_t nEntries = 0;
+  ULong64_t nUsed = 0;
+
+  if (!ofs) {
+    Logger::error("cannot open file {}", path);
+    return;
+  }
+  ofs << "simInfo\tentries\tused\trelError\tstopped\n";
+  for (const auto& earlyStop : m_earlyStops) {
+    if (earlyStop.simInfo.empty() == true) {
+      continue;
+    }
+    nEntries += earlyStop.nEntries;
+    nUsed += earlyStop.result.nEvents;
+    ofs << fmt::format(
+      "{}\t{}\t{}\t{:.3e}\t{}\n",
+      earlyStop.simInfo,
+      earlyStop.nEntries,
+      earlyStop.result.nEvents,
+      earlyStop.result.relError,
+      earlyStop.result.isStopped ? 1 : 0);
+  }
+  Logger::info(
+    "target precision {}: {} of {} events used",
+    m_options.targetPrecision,
+    nUsed,
+    nEntries);
+  Logger::info("early stopping is written to {}", path);
+}
+
+// one row per cell and column with the --preview estimators, in grid order.
+void
+HistManager::writePreviews()
+{
+  std::string path = fmt::format("{}preview.tsv", m_outputPrefix);
+  std::ofstream ofs(path);
+  const size_t nColumns = m_previewColumns.size();
+
+  if (!ofs) {
+    Logger::error("cannot open file {}", path);
+    return;
+  }
+  ofs << "simInfo\tcolumn\tevents\tmean\tstdDev\tmedian\ttruncatedMean\t"
+         "truncatedMeanError\tsigma\n";
+  for (size_t energyBin = 0; energyBin < m_energyBins.size(); ++energyBin) {
+    for (size_t etaBin = 0; etaBin < m_etaBins.size(); ++etaBin) {
+      size_t cellIndex = energyBin * m_etaBins.size() + etaBin;
+      for (size_t i = 0; i < nColumns; ++i) {
+        const Preview& preview = m_previews[cellIndex * nColumns + i];
+        if (preview.nEvents == 0) {
+          continue;
+        }
+        ofs << fmt::format(
+          "{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\t{}\n",
+          cellName(energyBin, etaBin),
+          m_previewColumns[i],
+          preview.nEvents,
+          preview.mean,
+          preview.stdDev,
+          preview.median,
+          preview.truncatedMean,
+          preview.truncatedMeanError,
+          preview.sigma);
+      }
+    }
+  }
+  Logger::info("preview estimators are written to {}", path);
+}
+
+// one row per cell and cut: simInfo, cut, events in, events passing.
+void
+HistManager::writeCutFlows()
+{
+  std::string path = fmt::format("{}cutflow.tsv", m_outputPrefix);
+  std::ofstream ofs(path);
+
+  if (!ofs) {
+    Logger::error("cannot open file {}", path);
+    return;
+  }
+  // cells arrive in completion order; write them in grid order.
+  std::sort(m_cutFlows.begin(), m_cutFlows.end(), [](const auto& a, const auto& b) {
+    return std::make_pair(a.energyBin, a.etaBin)
+           < std::make_pair(b.energyBin, b.etaBin);
+  });
+  ofs << "simInfo\tcut\tall\tpass\n";
+  for (const auto& [energyBin, etaBin, simInfo, rows] : m_cutFlows) {
+    for (const auto& row : rows) {
+      ofs << fmt::format(
+        "{}\t{}\t{}\t{}\n", simInfo, row.name, row.nAll, row.nPass);
+    }
+  }
+  Logger::info("cut flow is written to {}", path);
+}
+
+// sigma / mean and linearity of every eta row, fitted as one batch.
+void
+HistManager::fitResolution()
+{
+  std::vector<double> etaCenters(m_etaBins.size());
+
+  for (size_t j = 0; j < m_etaBins.size(); ++j) {
+    etaCenters[j] = m_etaBins.getMiddleValue(j);
+  }
+  Resolution resolution(
+    m_energyBins.getEnergyBins(),
+    etaCenters,
+    std::vector<CellFit>(m_cellFits.begin(), m_cellFits.end()));
+  // with --processes the cells ran in the workers; the supervisor starts
+  // its threads only now that no more workers are forked.
+  if (m_executor == nullptr) {
+    startThreads();
+  }
+  resolution.write(m_outputPrefix, resolution.fit(*m_executor));
 }
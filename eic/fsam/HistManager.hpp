@@ -2,19 +2,37 @@
 #define HISTMANAGER_HPP
 
 // C++
+#include <chrono>
+#include <map>
+#include <memory>
 #include <string>
 #include <vector>
 
 // ROOT
 #include "ROOT/RDataFrame.hxx"
-#include "TGraph2DErrors.h"
-#include "TH1D.h"
+#include "ROOT/TThreadExecutor.hxx"
 #include "TStyle.h"
 
 // headers
+#include "CellScheduler.hpp"
+#include "EarlyStop.hpp"
 #include "Energy.hpp"
 #include "Eta.hpp"
 #include "EventHist.hpp"
+#include "FitLadder.hpp"
+#include "FsamTable.hpp"
+#include "InputCatalog.hpp"
+#include "JitCounter.hpp"
+#include "MemoryMonitor.hpp"
+#include "Preview.hpp"
+#include "ProcessPool.hpp"
+#include "ProgressMonitor.hpp"
+#include "Resolution.hpp"
+#include "ResultMatrix.hpp"
+#include "RunOptions.hpp"
+#include "Selection.hpp"
+#include "SharedArray.hpp"
+#include "ShowerProfile.hpp"
 
 /*
  * Input:
@@ -23,10 +41,15 @@
  *
  * Process:
  *   1. select a pair of energy and eta from the list.
- *   2. get a ROOT file by them.
+ *      cells are scheduled under the memory budget of RunOptions, or run
+ *      by forked worker processes with --processes.
+ *   2. get a ROOT file by them from the catalog of the input directory.
  *   3. extract data nodes from the ROOT file.
  *   4. calculate sampling fraction using the data nodes.
- *   5. save the value to 2D graph, 1D Eta histogram and 1D Energy histogram.
+ *   5. save the value to the cell's slot of the results matrix.
+ *      --preview uses single pass estimators instead of fits in 4., see
+ *      Preview.hpp.
+ *   6. build 2D graphs, 1D Eta and 1D Energy histograms from the matrix.
  *
  * Output:
  *   1. a TGraph2DErrors and TH1D histograms
@@ -34,7 +57,10 @@
 class HistManager
 {
 public:
-  HistManager(const std::string& pathPrefix, bool isSensitive);
+  HistManager(
+    const std::string& pathPrefix,
+    bool isSensitive,
+    const RunOptions& options);
   ~HistManager();
 
   HistManager(const HistManager& histmanager) = delete;
@@ -45,28 +71,156 @@ public:
 
 private:
   void allocate();
+  void startThreads();
   void printBins();
+  std::string cellName(size_t energyBin, size_t etaBin) const;
+  std::vector<Cell> makeCells() const;
 
-  ROOT::RDF::RNode getDataNode(const std::string& simInfo);
-  void fillHists(
-    const std::string& simInfo,
-    size_t energyBin,
-    size_t etaBin,
+  // nRead counts the events read, before the selection and the
+  // --target-precision gate.
+  ROOT::RDF::RNode
+  getDataNode(const Cell& cell, ROOT::RDF::RResultPtr<ULong64_t>& nRead);
+  template<typename Sum>
+  ROOT::RDF::RNode defineColumns(ROOT::RDF::RNode dataNode);
+  bool fillHists(
+    const Cell& cell,
+    size_t worker,
+    ROOT::RDF::RNode& dataNode,
+    ROOT::RDF::RResultPtr<ULong64_t>& nRead);
+  std::vector<std::string> previewColumns(std::vector<bool>& isScan) const;
+  template<typename Sum>
+  bool previewCell(
+    const Cell& cell,
+    size_t worker,
+    ROOT::RDF::RNode& dataNode,
+    ROOT::RDF::RResultPtr<ULong64_t>& nRead);
+  void writePreviews();
+  void addCutFlow(
+    const Cell& cell,
+    ROOT::RDF::RResultPtr<ROOT::RDF::RCutFlowReport>& cutFlow);
+  ROOT::RDF::RResultPtr<ULong64_t> watchFirstEvent(
+    const Cell& cell,
+    std::chrono::steady_clock::time_point start,
     ROOT::RDF::RNode& dataNode);
+  void writeStartupReport();
+  void writeEarlyStops();
+  void addBootstrap(const Cell& cell, const EventHist& eventHist);
+  void writeBootstrapTrees();
+  ROOT::RDF::RResultPtr<ShowerProfile> bookProfile(ROOT::RDF::RNode& dataNode);
+  template<typename Sum>
+  ROOT::RDF::RResultPtr<ShowerProfile>
+  bookProfileWith(ROOT::RDF::RNode& dataNode);
+  void writeProfiles();
+  void writeFsamTable();
+  void writeCutFlows();
+  void writeThresholdScan();
+  void writeExport();
+  std::vector<std::string> eventColumns() const;
+  void writeGraph(
+    const std::string& columnName,
+    const std::string& title,
+    const std::string& fileName,
+    bool hasGridErrors);
+  void writeGridHists();
+  void fitResolution();
 
 private:
   TFile* m_file;
   const std::string m_pathPrefix;
+  // m_pathPrefix, or its preview/ directory with --preview.
+  const std::string m_outputPrefix;
 
-  TGraph2DErrors* m_fsam2DHist;
-  TGraph2DErrors* m_recEnergy2DHist;
-  TGraph2DErrors* m_simEnergy2DHist;
-  std::vector<TH1D*> m_energyHistArr;
-  std::vector<TH1D*> m_etaHistArr;
 
   bool m_isSensitive;
+  const RunOptions m_options;
   const Energy m_energyBins;
   const Eta m_etaBins;
+  MemoryMonitor m_memoryMonitor;
+  std::unique_ptr<ProgressMonitor> m_progress;
+
+  // bootstrap replicas per column, guarded by histMutex.
+  struct BootstrapRow
+  {
+    size_t energyBin;
+    size_t etaBin;
+    BootstrapResult result;
+  };
+  std::map<std::string, std::vector<BootstrapRow>> m_bootstrapRows;
+
+  // bootstrap replicas, --fit-ladder strategies and resolution rows run as
+  // tasks of the same arena as the event loops.
+  std::unique_ptr<ROOT::TThreadExecutor> m_executor;
+  std::unique_ptr<FitLadder> m_fitLadder;
+
+  // shower profile per cell, guarded by histMutex.
+  struct ProfileRow
+  {
+    size_t energyBin;
+    size_t etaBin;
+    std::string simInfo;
+    ShowerProfile profile;
+  };
+  std::vector<ProfileRow> m_profiles;
+
+  // fitted mean and error of every result column per cell, written by the
+  // cell workers without a lock. the 2D graphs, the 1D histograms,
+  // fsamTable.bin and the export are built from it in storeHists().
+  ResultMatrix m_results;
+  // mean and width of the energy column per cell for the resolution fits,
+  // one shared slot per cell like m_results.
+  SharedArray<CellFit> m_cellFits;
+  // table of --fsam-table used for recEnergy instead of eicrecon_fsam.
+  FsamTable m_fsamTable;
+
+  // values of eventColumns() of every event per cell for --export-events,
+  // guarded by histMutex.
+  struct EventRows
+  {
+    size_t energyBin;
+    size_t etaBin;
+    std::vector<std::vector<double>> columns;
+  };
+  std::vector<EventRows> m_eventRows;
+
+  // --startup-report per cell, energy major. every cell writes its own
+  // slot, so no lock.
+  struct CellStartup
+  {
+    std::string simInfo;
+    double timeToFirstEvent = -1.;
+    size_t nJits = 0;
+  };
+  std::vector<CellStartup> m_startups;
+  std::unique_ptr<JitCounter> m_jitCounter;
+
+  // --target-precision per cell, energy major. the flag is shared by the
+  // gate Filter of getDataNode() and the EarlyStopHelper of fillHists().
+  struct CellEarlyStop
+  {
+    std::string simInfo;
+    ULong64_t nEntries = 0;
+    std::shared_ptr<std::atomic<bool>> isStopped;
+    EarlyStop result;
+  };
+  std::vector<CellEarlyStop> m_earlyStops;
+
+  // --preview estimators of m_previewColumns per cell, energy major, one
+  // shared slot per cell and column like m_results. columns of the
+  // threshold scan are marked in m_isPreviewScan.
+  std::vector<std::string> m_previewColumns;
+  std::vector<bool> m_isPreviewScan;
+  SharedArray<Preview> m_previews;
+
+  // cuts of --selection and their counts per cell, guarded by histMutex.
+  Selection m_selection;
+  struct CutFlow
+  {
+    size_t energyBin;
+    size_t etaBin;
+    std::string simInfo;
+    std::vector<CutFlowRow> rows;
+  };
+  std::vector<CutFlow> m_cutFlows;
 };
 
 #endif // HISTMANAGER_HPP
@@ -0,0 +1,95 @@
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <filesystem>
+#include <regex>
+
+#include "InputCatalog.hpp"
+#include "Logger.hpp"
+
+bool
+InputCatalog::scan(const std::string& directory)
+{
+  std::error_code error;
+  std::filesystem::directory_iterator it(directory, error);
+
+  m_files.clear();
+  if (error) {
+    Logger::error("cannot list {}: {}", directory, error.message());
+    return false;
+  }
+  for (const auto& entry : it) {
+    CatalogFile file;
+    if (entry.is_regular_file(error) == false
+        || parseName(entry.path().filename().string(), file) == false) {
+      Logger::debug("not an input file: {}", entry.path().string());
+      continue;
+    }
+    file.path = entry.path().string();
+    file.fileSize = entry.file_size(error);
+    if (error) {
+      file.fileSize = 0;
+    }
+    m_files.push_back(file);
+  }
+  std::sort(m_files.begin(), m_files.end(), [](const auto& a, const auto& b) {
+    return a.path < b.path;
+  });
+  return true;
+}
+
+const CatalogFile*
+InputCatalog::take(double energy, double etaLow, double etaHigh)
+{
+  for (auto& file : m_files) {
+    if (file.isUsed == false && isSame(file.energy, energy)
+        && isSame(file.etaLow, etaLow) && isSame(file.etaHigh, etaHigh)) {
+      file.isUsed = true;
+      return &file;
+    }
+  }
+  return nullptr;
+}
+
+std::vector<const CatalogFile*>
+InputCatalog::unused() const
+{
+  std::vector<const CatalogFile*> files;
+
+  for (const auto& file : m_files) {
+    if (file.isUsed == false) {
+      files.push_back(&file);
+    }
+  }
+  return files;
+}
+
+bool
+InputCatalog::parseName(const std::string& name, CatalogFile& file)
+{
+  static const std::regex pattern(
+    R"(rec_E([-+.0-9eE]+)_H([-+.0-9eE]+)t([-+.0-9eE]+)\.root)");
+  std::smatch match;
+
+  if (std::regex_match(name, match, pattern) == false) {
+    return false;
+  }
+  double* values[] = { &file.energy, &file.etaLow, &file.etaHigh };
+  for (size_t i = 0; i < 3; ++i) {
+    std::string text = match[i + 1].str();
+    char* end = nullptr;
+    *values[i] = std::strtod(text.c_str(), &end);
+    if (end != text.c_str() + text.size()) {
+      return false;
+    }
+  }
+  return true;
+}
+
+// names carry at most a few decimals of the range files.
+bool
+InputCatalog::isSame(double a, double b)
+{
+  return std::fabs(a - b) <= 1e-6 * std::max(1., std::fabs(b));
+}
@@ -0,0 +1,61 @@
+#ifndef INPUTCATALOG_HPP
+#define INPUTCATALOG_HPP
+
+// C++
+#include <string>
+#include <vector>
+
+// one reconstructed file found in the input directory.
+struct CatalogFile
+{
+  std::string path;
+  double energy;
+  double etaLow;
+  double etaHigh;
+  // bytes.
+  size_t fileSize;
+  bool isUsed = false;
+};
+
+/*
+ * files of the input directory mapped to grid cells by their names,
+ * rec_E<energy>_H<eta low>t<eta high>.root as written by eic_fsam_sim.sh.
+ * the numbers are compared by value, not by text, so a file written as
+ * E1_H0t0.5 is found for the cell E1.00_H0.0t0.5. the directory is listed
+ * once; every cell then looks its file up in the catalog.
+ */
+class InputCatalog
+{
+public:
+  InputCatalog() = default;
+  ~InputCatalog() = default;
+
+  InputCatalog(const InputCatalog& catalog) = delete;
+  InputCatalog& operator=(const InputCatalog& catalog) = delete;
+
+  // false if the directory cannot be listed. names not following the
+  // pattern are skipped.
+  bool scan(const std::string& directory);
+
+  // file of a cell, nullptr if there is none. a file is given to one cell
+  // only, so a second file of the same cell stays unused.
+  const CatalogFile* take(double energy, double etaLow, double etaHigh);
+
+  // files no cell of the grid has taken.
+  std::vector<const CatalogFile*> unused() const;
+
+  size_t size() const
+  {
+    return m_files.size();
+  };
+
+private:
+  static bool parseName(const std::string& name, CatalogFile& file);
+  static bool isSame(double a, double b);
+
+private:
+  // sorted by path, so duplicates resolve the same way on every run.
+  std::vector<CatalogFile> m_files;
+};
+
+#endif // INPUTCATALOG_HPP
@@ -0,0 +1,66 @@
+// C++
+#include <memory>
+#include <string>
+
+// ROOT
+#include "ROOT/RDataFrame.hxx"
+
+#include "JitCounter.hpp"
+
+using ROOT::Experimental::ELogLevel;
+using ROOT::Experimental::RLogEntry;
+using ROOT::Experimental::RLogManager;
+
+std::atomic<size_t> JitCounter::s_total(0);
+
+namespace
+{
+
+thread_local size_t threadJits = 0;
+
+// "Just-in-time compilation phase completed in ..." of RLoopManager::Jit().
+// "Nothing to jit and execute." is logged when there was nothing to compile.
+const std::string jitMessage = "Just-in-time compilation phase completed";
+
+} // namespace
+
+class JitCounter::Handler : public ROOT::Experimental::RLogHandler
+{
+public:
+  // returns false to stop the entry from reaching the default handler.
+  bool Emit(const RLogEntry& entry) override
+  {
+    if (entry.fChannel != &ROOT::Detail::RDF::RDFLogChannel()) {
+      return true;
+    }
+    if (entry.fMessage.rfind(jitMessage, 0) == 0) {
+      ++threadJits;
+      ++s_total;
+    }
+    return entry.fLevel != ELogLevel::kInfo && entry.fLevel != ELogLevel::kDebug;
+  }
+};
+
+JitCounter::JitCounter()
+  : m_handler(new Handler())
+  , m_verbosity(ROOT::Detail::RDF::RDFLogChannel(), ELogLevel::kInfo)
+{
+  RLogManager::Get().PushFront(std::unique_ptr<Handler>(m_handler));
+}
+
+JitCounter::~JitCounter()
+{
+  RLogManager::Get().Remove(m_handler);
+}
+
+size_t
+JitCounter::total()
+{
+  return s_total.load();
+}
+
+size_t
+JitCounter::threadCount()
+{
+  return threadJits;
+}
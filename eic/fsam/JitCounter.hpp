@@ -0,0 +1,42 @@
+#ifndef JITCOUNTER_HPP
+#define JITCOUNTER_HPP
+
+// C++
+#include <atomic>
+#include <cstddef>
+
+// ROOT
+#include "ROOT/RLogger.hxx"
+
+/*
+ * counts the just-in-time compilations of RDataFrame while alive.
+ * RDataFrame logs every jitting phase of an event loop on its channel at
+ * info level. the counter raises the channel to info, counts those entries
+ * and swallows the channel's info and debug entries, so the output does
+ * not change. entries are emitted by the thread that starts the event loop,
+ * so the per thread count of a cell worker is the count of its cells.
+ * one counter at a time.
+ */
+class JitCounter
+{
+public:
+  JitCounter();
+  ~JitCounter();
+
+  JitCounter(const JitCounter& counter) = delete;
+  JitCounter& operator=(const JitCounter& counter) = delete;
+
+  static size_t total();
+  static size_t threadCount();
+
+private:
+  class Handler;
+
+  // owned by RLogManager.
+  Handler* m_handler;
+  ROOT::Experimental::RLogScopedVerbosity m_verbosity;
+
+  static std::atomic<size_t> s_total;
+};
+
+#endif // JITCOUNTER_HPP
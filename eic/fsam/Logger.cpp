@@ -0,0 +1,375 @@
+// C++
+#include <algorithm>
+#include <chrono>
+#include <condition_variable>
+#include <cstdio>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// POSIX
+#include <pthread.h>
+
+#include "Logger.hpp"
+
+std::atomic<int> Logger::s_level(Logger::kInfo);
+
+namespace
+{
+
+struct Record
+{
+  double time;
+  Logger::Level level;
+  size_t thread;
+  std::string cell;
+  const char* stage;
+  std::string message;
+};
+
+// single producer (the owning thread), single consumer (the flusher).
+struct Ring
+{
+  static const size_t s_size = 4096;
+
+  std::vector<Record> records{ s_size };
+  alignas(64) std::atomic<size_t> head{ 0 };
+  alignas(64) std::atomic<size_t> tail{ 0 };
+  std::atomic<size_t> nDropped{ 0 };
+  std::atomic<bool> isClosed{ false };
+  size_t thread = 0;
+
+  bool push(Record&& record)
+  {
+    size_t h = head.load(std::memory_order_relaxed);
+    if (h - tail.load(std::memory_order_acquire) == s_size) {
+      nDropped.fetch_add(1, std::memory_order_relaxed);
+      return false;
+    }
+    records[h % s_size] = std::move(record);
+    head.store(h + 1, std::memory_order_release);
+    return true;
+  }
+
+  void pop(std::vector<Record>& out)
+  {
+    size_t t = tail.load(std::memory_order_relaxed);
+    size_t h = head.load(std::memory_order_acquire);
+    for (; t != h; ++t) {
+      out.push_back(std::move(records[t % s_size]));
+    }
+    tail.store(t, std::memory_order_release);
+  }
+};
+
+const char* levelNames[] = { "DEBUG", "INFO ", "WARN ", "ERROR" };
+
+void
+onForkPrepare();
+void
+onForkParent();
+void
+onForkChild();
+
+// rings of all threads and the flusher thread.
+class Registry
+{
+public:
+  Registry()
+    : m_start(std::chrono::steady_clock::now())
+    , m_nThreads(0)
+    , m_isStopped(false)
+  {
+    m_cv = std::make_unique<std::condition_variable>();
+    m_flusher = std::make_unique<std::thread>(&Registry::run, this);
+    pthread_atfork(onForkPrepare, onForkParent, onForkChild);
+  }
+
+  ~Registry()
+  {
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_isStopped = true;
+    }
+    m_cv->notify_all();
+    m_flusher->join();
+  }
+
+  std::shared_ptr<Ring> addRing()
+  {
+    auto ring = std::make_shared<Ring>();
+    std::lock_guard<std::mutex> lock(m_mutex);
+    ring->thread = m_nThreads++;
+    m_rings.push_back(ring);
+    return ring;
+  }
+
+  double now() const
+  {
+    return std::chrono::duration<double>(
+             std::chrono::steady_clock::now() - m_start)
+      .count();
+  }
+
+  void flush()
+  {
+    std::lock_guard<std::mutex> lock(m_flushMutex);
+    drain();
+  }
+
+  void setSink(Logger::Sink sink)
+  {
+    std::lock_guard<std::mutex> lock(m_flushMutex);
+    m_sink = std::move(sink);
+  }
+
+  // the forking thread holds both mutexes across fork(), so no flush or
+  // new ring is in progress, and its own ring is drained. other threads
+  // keep pushing until the fork; their copied rings in the child are
+  // dropped, and the parent writes those records once. the flusher does
+  // not exist in the child: its thread object and condition variable are
+  // leaked, because destroying or reusing them there is undefined, and
+  // the child starts a new flusher.
+  void prepareFork()
+  {
+    m_flushMutex.lock();
+    drain();
+    m_mutex.lock();
+  }
+
+  void parentAfterFork()
+  {
+    m_mutex.unlock();
+    m_flushMutex.unlock();
+  }
+
+  void childAfterFork(const std::shared_ptr<Ring>& ownRing)
+  {
+    m_rings.clear();
+    if (ownRing != nullptr) {
+      m_rings.push_back(ownRing);
+    }
+    m_mutex.unlock();
+    m_flushMutex.unlock();
+    m_cv.release();
+    m_flusher.release();
+    m_cv = std::make_unique<std::condition_variable>();
+    m_flusher = std::make_unique<std::thread>(&Registry::run, this);
+  }
+
+private:
+  void run()
+  {
+    std::unique_lock<std::mutex> lock(m_mutex);
+
+    while (true) {
+      bool isStopped = m_cv->wait_for(
+        lock, std::chrono::milliseconds(s_periodMs), [this]() {
+          return m_isStopped;
+        });
+      lock.unlock();
+      flush();
+      lock.lock();
+      if (isStopped == true) {
+        return;
+      }
+    }
+  }
+
+  // caller holds m_flushMutex.
+  void drain()
+  {
+    std::vector<std::shared_ptr<Ring>> rings;
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      // rings of finished threads are dropped once they are empty.
+      m_rings.erase(
+        std::remove_if(
+          m_rings.begin(),
+          m_rings.end(),
+          [](const std::shared_ptr<Ring>& ring) {
+            return ring->isClosed.load()
+                   && ring->tail.load() == ring->head.load();
+          }),
+        m_rings.end());
+      rings = m_rings;
+    }
+
+    m_records.clear();
+    for (auto& ring : rings) {
+      ring->pop(m_records);
+      size_t nDropped = ring->nDropped.exchange(0);
+      if (nDropped > 0) {
+        m_records.push_back(Record{ now(),
+                                    Logger::kWarning,
+                                    ring->thread,
+                                    "-",
+                                    "log",
+                                    fmt::format("{} records dropped", nDropped) });
+      }
+    }
+    std::stable_sort(
+      m_records.begin(), m_records.end(), [](const Record& a, const Record& b) {
+        return a.time < b.time;
+      });
+
+    m_out.clear();
+    m_err.clear();
+    for (const auto& record : m_records) {
+      std::string& buffer = record.level >= Logger::kWarning ? m_err : m_out;
+      size_t begin = buffer.size();
+      buffer += fmt::format(
+        "{:.3f} {} thread={} cell={} stage={} | {}\n",
+        record.time,
+        levelNames[record.level],
+        record.thread,
+        record.cell.empty() ? "-" : record.cell,
+        record.stage == nullptr ? "-" : record.stage,
+        record.message);
+      if (m_sink) {
+        m_sink(record.level, buffer.substr(begin));
+      }
+    }
+    if (m_out.empty() == false) {
+      std::fwrite(m_out.data(), 1, m_out.size(), stdout);
+      std::fflush(stdout);
+    }
+    if (m_err.empty() == false) {
+      std::fwrite(m_err.data(), 1, m_err.size(), stderr);
+    }
+  }
+
+private:
+  const std::chrono::steady_clock::time_point m_start;
+  std::vector<std::shared_ptr<Ring>> m_rings;
+  size_t m_nThreads;
+  std::mutex m_mutex;
+  std::mutex m_flushMutex;
+  std::unique_ptr<std::condition_variable> m_cv;
+  std::unique_ptr<std::thread> m_flusher;
+  bool m_isStopped;
+
+  // flusher buffers, guarded by m_flushMutex.
+  std::vector<Record> m_records;
+  std::string m_out;
+  std::string m_err;
+  Logger::Sink m_sink;
+
+  static constexpr unsigned s_periodMs = 50;
+};
+
+Registry&
+registry()
+{
+  static Registry instance;
+  return instance;
+}
+
+// ring and context fields of the calling thread.
+struct ThreadState
+{
+  std::shared_ptr<Ring> ring;
+  std::string cell;
+  const char* stage = nullptr;
+
+  ~ThreadState()
+  {
+    if (ring != nullptr) {
+      ring->isClosed = true;
+    }
+  }
+};
+
+thread_local ThreadState threadState;
+
+void
+onForkPrepare()
+{
+  registry().prepareFork();
+}
+
+void
+onForkParent()
+{
+  registry().parentAfterFork();
+}
+
+void
+onForkChild()
+{
+  registry().childAfterFork(threadState.ring);
+}
+
+} // namespace
+
+void
+Logger::setLevel(Level level)
+{
+  s_level.store(level, std::memory_order_relaxed);
+}
+
+bool
+Logger::parseLevel(const std::string& name, Level& level)
+{
+  const std::pair<const char*, Level> levels[] = { { "debug", kDebug },
+                                                   { "info", kInfo },
+                                                   { "warning", kWarning },
+                                                   { "error", kError } };
+  for (const auto& [levelName, value] : levels) {
+    if (name == levelName) {
+      level = value;
+      return true;
+    }
+  }
+  return false;
+}
+
+void
+Logger::flush()
+{
+  registry().flush();
+}
+
+void
+Logger::setSink(Sink sink)
+{
+  registry().setSink(std::move(sink));
+}
+
+void
+Logger::push(Level level, std::string&& message)
+{
+  Registry& instance = registry();
+
+  if (threadState.ring == nullptr) {
+    threadState.ring = instance.addRing();
+  }
+  threadState.ring->push(Record{ instance.now(),
+                                 level,
+                                 threadState.ring->thread,
+                                 threadState.cell,
+                                 threadState.stage,
+                                 std::move(message) });
+}
+
+LogContext::LogContext(const std::string& cell, const char* stage)
+  : m_cell(std::move(threadState.cell))
+  , m_stage(threadState.stage)
+{
+  threadState.cell = cell;
+  threadState.stage = stage;
+}
+
+LogContext::LogContext(const char* stage)
+  : m_cell(threadState.cell)
+  , m_stage(threadState.stage)
+{
+  threadState.stage = stage;
+}
+
+LogContext::~LogContext()
+{
+  threadState.cell = std::move(m_cell);
+  threadState.stage = m_stage;
+}
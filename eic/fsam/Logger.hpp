@@ -0,0 +1,108 @@
+#ifndef LOGGER_HPP
+#define LOGGER_HPP
+
+// C++
+#include <atomic>
+#include <functional>
+#include <string>
+#include <utility>
+
+#include <fmt/core.h>
+
+/*
+ * asynchronous leveled logger.
+ * each thread appends records to its own lock-free ring buffer and a
+ * background flusher writes them in time order, one line per record:
+ *
+ *   12.345 INFO  thread=3 cell=E1.00_H0.0t0.1 stage=fit | message
+ *
+ * a disabled level costs one relaxed atomic load; the message is not
+ * formatted. a full ring drops records instead of blocking the caller and
+ * the number of dropped records is reported by the flusher.
+ * warnings and errors go to stderr, the rest to stdout.
+ */
+class Logger
+{
+public:
+  enum Level : int
+  {
+    kDebug = 0,
+    kInfo = 1,
+    kWarning = 2,
+    kError = 3
+  };
+
+  static void setLevel(Level level);
+  // debug, info, warning or error.
+  static bool parseLevel(const std::string& name, Level& level);
+  static bool isEnabled(Level level)
+  {
+    return level >= s_level.load(std::memory_order_relaxed);
+  }
+
+  template<typename... Args>
+  static void debug(fmt::format_string<Args...> format, Args&&... args)
+  {
+    log(kDebug, format, std::forward<Args>(args)...);
+  }
+  template<typename... Args>
+  static void info(fmt::format_string<Args...> format, Args&&... args)
+  {
+    log(kInfo, format, std::forward<Args>(args)...);
+  }
+  template<typename... Args>
+  static void warning(fmt::format_string<Args...> format, Args&&... args)
+  {
+    log(kWarning, format, std::forward<Args>(args)...);
+  }
+  template<typename... Args>
+  static void error(fmt::format_string<Args...> format, Args&&... args)
+  {
+    log(kError, format, std::forward<Args>(args)...);
+  }
+
+  // writes every record pushed so far before returning.
+  static void flush();
+
+  // also receives every formatted line, newline included, on the flusher
+  // thread. an empty sink removes it. used by the daemon to stream a job's
+  // log to its client.
+  using Sink = std::function<void(Level level, const std::string& line)>;
+  static void setSink(Sink sink);
+
+private:
+  template<typename... Args>
+  static void log(Level level, fmt::format_string<Args...> format, Args&&... args)
+  {
+    if (isEnabled(level) == false) {
+      return;
+    }
+    push(level, fmt::format(format, std::forward<Args>(args)...));
+  }
+  static void push(Level level, std::string&& message);
+
+private:
+  static std::atomic<int> s_level;
+};
+
+/*
+ * cell and stage fields of the records of the current thread.
+ * contexts nest; the destructor restores the enclosing fields.
+ */
+class LogContext
+{
+public:
+  LogContext(const std::string& cell, const char* stage);
+  // keeps the cell of the enclosing context.
+  explicit LogContext(const char* stage);
+  ~LogContext();
+
+  LogContext(const LogContext& context) = delete;
+  LogContext& operator=(const LogContext& context) = delete;
+
+private:
+  std::string m_cell;
+  const char* m_stage;
+};
+
+#endif // LOGGER_HPP
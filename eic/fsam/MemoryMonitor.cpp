@@ -0,0 +1,104 @@
+#include <fstream>
+#include <sstream>
+
+#include <fmt/core.h>
+#include <unistd.h>
+
+#include "Logger.hpp"
+#include "MemoryMonitor.hpp"
+
+MemoryMonitor::MemoryMonitor(unsigned periodMs)
+  : m_periodMs(periodMs)
+  , m_isStopped(false)
+{
+  m_sampler = std::thread(&MemoryMonitor::sample, this);
+}
+
+MemoryMonitor::~MemoryMonitor()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopped = true;
+  }
+  m_cv.notify_all();
+  m_sampler.join();
+}
+
+void
+MemoryMonitor::beginStage(const std::string& name)
+{
+  size_t rss = currentRss();
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  m_stagePeaks.emplace_back(name, rss);
+}
+
+void
+MemoryMonitor::printReport() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+
+  Logger::info("peak RSS per stage:");
+  for (const auto& [name, peak] : m_stagePeaks) {
+    Logger::info("  {:<12} {:8.1f} MB", name, peak / 1048576.);
+  }
+  Logger::info("  {:<12} {:8.1f} MB", "total", peakRss() / 1048576.);
+}
+
+void
+MemoryMonitor::pause()
+{
+  m_mutex.lock();
+}
+
+void
+MemoryMonitor::resume()
+{
+  m_mutex.unlock();
+}
+
+size_t
+MemoryMonitor::currentRss()
+{
+  std::ifstream statm("/proc/self/statm");
+  size_t totalPages = 0;
+  size_t residentPages = 0;
+
+  if (!(statm >> totalPages >> residentPages)) {
+    return 0;
+  }
+  return residentPages * static_cast<size_t>(sysconf(_SC_PAGESIZE));
+}
+
+size_t
+MemoryMonitor::peakRss()
+{
+  std::ifstream status("/proc/self/status");
+  std::string line;
+
+  while (std::getline(status, line)) {
+    if (line.rfind("VmHWM:", 0) == 0) {
+      std::stringstream ss(line.substr(6));
+      size_t kb = 0;
+      ss >> kb;
+      return kb * 1024;
+    }
+  }
+  return 0;
+}
+
+void
+MemoryMonitor::sample()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+
+  // the read happens under the lock so pause() holds the sampler outside
+  // of it.
+  while (m_isStopped == false) {
+    size_t rss = currentRss();
+    if (m_stagePeaks.empty() == false && m_stagePeaks.back().second < rss) {
+      m_stagePeaks.back().second = rss;
+    }
+    m_cv.wait_for(lock, std::chrono::milliseconds(m_periodMs));
+  }
+}
@@ -0,0 +1,50 @@
+#ifndef MEMORYMONITOR_HPP
+#define MEMORYMONITOR_HPP
+
+// C++
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+/*
+ * samples resident set size of the process in the background
+ * and keeps the peak value for each named stage.
+ * stages are sequential; beginStage() closes the previous one.
+ */
+class MemoryMonitor
+{
+public:
+  explicit MemoryMonitor(unsigned periodMs = 100);
+  ~MemoryMonitor();
+
+  MemoryMonitor(const MemoryMonitor& monitor) = delete;
+  MemoryMonitor& operator=(const MemoryMonitor& monitor) = delete;
+
+  void beginStage(const std::string& name);
+  void printReport() const;
+  // holds the sampler between two samples, e.g. across fork(); no other
+  // call may be made on the monitor until resume().
+  void pause();
+  void resume();
+
+  // in bytes, read from /proc/self. 0 if not available.
+  static size_t currentRss();
+  static size_t peakRss();
+
+private:
+  void sample();
+
+private:
+  std::vector<std::pair<std::string, size_t>> m_stagePeaks;
+  mutable std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::thread m_sampler;
+  unsigned m_periodMs;
+  bool m_isStopped;
+};
+
+#endif // MEMORYMONITOR_HPP
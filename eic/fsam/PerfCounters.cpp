@@ -0,0 +1,269 @@
+// C++
+#include <cerrno>
+#include <cstring>
+#include <fstream>
+#include <memory>
+#include <mutex>
+#include <vector>
+
+// POSIX
+#include <linux/perf_event.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+#include "Logger.hpp"
+#include "PerfCounters.hpp"
+
+const char* const PerfCounters::s_stageNames[kNStages] = {
+  "open", "eventLoop", "conversion", "fit", "render"
+};
+const char* const PerfCounters::s_counterNames[kNCounters] = {
+  "cycles", "instructions", "cacheMisses", "branchMisses"
+};
+
+std::atomic<bool> PerfCounters::s_isEnabled(false);
+
+namespace
+{
+
+const int nCounters = PerfCounters::kNCounters;
+const int nStages = PerfCounters::kNStages;
+// counters, then time enabled and time running of the group.
+const int nValues = nCounters + 2;
+
+const uint64_t configs[nCounters] = { PERF_COUNT_HW_CPU_CYCLES,
+                                      PERF_COUNT_HW_INSTRUCTIONS,
+                                      PERF_COUNT_HW_CACHE_MISSES,
+                                      PERF_COUNT_HW_BRANCH_MISSES };
+
+// written by its own thread only, read by write() after the cells.
+struct ThreadTotals
+{
+  long tid = 0;
+  bool isCounting[nCounters] = {};
+  std::atomic<uint64_t> values[nStages][nValues] = {};
+  std::atomic<uint64_t> nCalls[nStages] = {};
+};
+
+std::mutex totalsMutex;
+std::vector<std::shared_ptr<ThreadTotals>> allTotals;
+
+// counter group of the calling thread, opened on first use.
+struct ThreadGroup
+{
+  bool isTried = false;
+  int fds[nCounters] = { -1, -1, -1, -1 };
+  // position of every counter in a group read, -1 if it is not open.
+  int positions[nCounters] = { -1, -1, -1, -1 };
+  int nOpen = 0;
+  std::shared_ptr<ThreadTotals> totals;
+
+  ~ThreadGroup()
+  {
+    for (int fd : fds) {
+      if (fd >= 0) {
+        close(fd);
+      }
+    }
+  }
+
+  // errno of the group leader on failure.
+  bool open(int& error)
+  {
+    if (isTried == true) {
+      error = 0;
+      return fds[0] >= 0;
+    }
+    isTried = true;
+    for (int i = 0; i < nCounters; ++i) {
+      perf_event_attr attr{};
+      attr.size = sizeof(attr);
+      attr.type = PERF_TYPE_HARDWARE;
+      attr.config = configs[i];
+      attr.exclude_kernel = 1;
+      attr.exclude_hv = 1;
+      attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED
+                         | PERF_FORMAT_TOTAL_TIME_RUNNING;
+      fds[i] = syscall(
+        SYS_perf_event_open, &attr, 0, -1, i == 0 ? -1 : fds[0], PERF_FLAG_FD_CLOEXEC);
+      if (fds[i] < 0 && i == 0) {
+        error = errno;
+        return false;
+      }
+      if (fds[i] >= 0) {
+        positions[i] = nOpen++;
+      }
+    }
+    totals = std::make_shared<ThreadTotals>();
+    totals->tid = syscall(SYS_gettid);
+    for (int i = 0; i < nCounters; ++i) {
+      totals->isCounting[i] = positions[i] >= 0;
+    }
+    std::lock_guard<std::mutex> lock(totalsMutex);
+    allTotals.push_back(totals);
+    return true;
+  }
+
+  bool read(uint64_t* values)
+  {
+    uint64_t buffer[3 + nCounters];
+    ssize_t size = (3 + nOpen) * sizeof(uint64_t);
+
+    if (::read(fds[0], buffer, size) != size) {
+      return false;
+    }
+    for (int i = 0; i < nCounters; ++i) {
+      values[i] = positions[i] >= 0 ? buffer[3 + positions[i]] : 0;
+    }
+    values[nCounters] = buffer[1];
+    values[nCounters + 1] = buffer[2];
+    return true;
+  }
+};
+
+thread_local ThreadGroup threadGroup;
+
+// counters scaled up by the time the group was not on the PMU.
+struct Row
+{
+  uint64_t nCalls = 0;
+  double values[nCounters] = {};
+  bool isCounting[nCounters] = {};
+};
+
+void
+addScaled(Row& row, const ThreadTotals& totals, int stage)
+{
+  double enabled = totals.values[stage][nCounters].load();
+  double running = totals.values[stage][nCounters + 1].load();
+  double scale = running > 0. && running < enabled ? enabled / running : 1.;
+
+  row.nCalls += totals.nCalls[stage].load();
+  for (int i = 0; i < nCounters; ++i) {
+    row.values[i] += totals.values[stage][i].load() * scale;
+    row.isCounting[i] = row.isCounting[i] || totals.isCounting[i];
+  }
+}
+
+std::string
+formatRow(const Row& row)
+{
+  std::string line = fmt::format("{}", row.nCalls);
+
+  for (int i = 0; i < nCounters; ++i) {
+    line += row.isCounting[i] ? fmt::format("\t{:.0f}", row.values[i]) : "\t-";
+  }
+  double cycles = row.values[PerfCounters::kCycles];
+  line += cycles > 0. ? fmt::format(
+                          "\t{:.3f}",
+                          row.values[PerfCounters::kInstructions] / cycles)
+                      : "\t-";
+  return line;
+}
+
+} // namespace
+
+bool
+PerfCounters::enable()
+{
+  int error = 0;
+
+  if (threadGroup.open(error) == false) {
+    Logger::warning(
+      "hardware counters unavailable ({}), --perf-counters is ignored",
+      error == 0 ? "not supported" : std::strerror(error));
+    return false;
+  }
+  for (int i = 0; i < nCounters; ++i) {
+    if (threadGroup.positions[i] < 0) {
+      Logger::warning("no {} counter on this CPU", s_counterNames[i]);
+    }
+  }
+  std::lock_guard<std::mutex> lock(totalsMutex);
+  for (auto& totals : allTotals) {
+    for (int stage = 0; stage < nStages; ++stage) {
+      totals->nCalls[stage] = 0;
+      for (auto& value : totals->values[stage]) {
+        value = 0;
+      }
+    }
+  }
+  s_isEnabled = true;
+  return true;
+}
+
+bool
+PerfCounters::write(const std::string& path)
+{
+  std::ofstream ofs(path);
+
+  s_isEnabled = false;
+  if (!ofs) {
+    Logger::error("cannot open file {}", path);
+    return false;
+  }
+  std::lock_guard<std::mutex> lock(totalsMutex);
+  ofs << "stage\tthread\tcalls";
+  for (const char* name : s_counterNames) {
+    ofs << "\t" << name;
+  }
+  ofs << "\tinstructionsPerCycle\n";
+  for (int stage = 0; stage < nStages; ++stage) {
+    Row all;
+    for (const auto& totals : allTotals) {
+      if (totals->nCalls[stage].load() == 0) {
+        continue;
+      }
+      Row row;
+      addScaled(row, *totals, stage);
+      addScaled(all, *totals, stage);
+      ofs << fmt::format(
+        "{}\t{}\t{}\n", s_stageNames[stage], totals->tid, formatRow(row));
+    }
+    ofs << fmt::format("{}\tall\t{}\n", s_stageNames[stage], formatRow(all));
+    if (all.nCalls > 0) {
+      Logger::info(
+        "{}: {:.3g} cycles, {:.2f} instructions per cycle, {:.3g} cache "
+        "misses, {:.3g} branch misses",
+        s_stageNames[stage],
+        all.values[kCycles],
+        all.values[kCycles] > 0. ? all.values[kInstructions] / all.values[kCycles]
+                                 : 0.,
+        all.values[kCacheMisses],
+        all.values[kBranchMisses]);
+    }
+  }
+  Logger::info("hardware counters are written to {}", path);
+  return true;
+}
+
+PerfScope::PerfScope(PerfCounters::Stage stage)
+  : m_stage(stage)
+  , m_isActive(false)
+{
+  int error = 0;
+
+  if (PerfCounters::isEnabled() == true && threadGroup.open(error) == true) {
+    m_isActive = threadGroup.read(m_begin);
+  }
+}
+
+PerfScope::~PerfScope()
+{
+  uint64_t end[nValues];
+
+  if (m_isActive == false || threadGroup.read(end) == false) {
+    return;
+  }
+  ThreadTotals& totals = *threadGroup.totals;
+  for (int i = 0; i < nValues; ++i) {
+    auto& value = totals.values[m_stage][i];
+    value.store(
+      value.load(std::memory_order_relaxed) + end[i] - m_begin[i],
+      std::memory_order_relaxed);
+  }
+  auto& nCalls = totals.nCalls[m_stage];
+  nCalls.store(nCalls.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
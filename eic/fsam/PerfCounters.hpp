@@ -0,0 +1,80 @@
+#ifndef PERFCOUNTERS_HPP
+#define PERFCOUNTERS_HPP
+
+// C++
+#include <atomic>
+#include <cstdint>
+#include <string>
+
+/*
+ * hardware counters of the HistManager stages (--perf-counters).
+ * every thread entering a PerfScope opens one perf_event_open group of its
+ * own, user space only: cycles, instructions, cache misses and branch
+ * misses. a scope reads the group when it begins and ends and adds the
+ * difference to the stage's totals of its thread.
+ *
+ * stages are inclusive and per thread: an event loop counts the
+ * conversions its thread ran, and with implicit MT the conversions of the
+ * other threads appear only under their own thread. conversions run per
+ * event, so they add two reads of the group to every event while enabled.
+ *
+ * without counters (no PMU, perf_event_paranoid, seccomp) enable() warns
+ * and scopes do nothing; a disabled scope costs one relaxed atomic load.
+ * counters of a thread that cannot open them are left out of the totals.
+ */
+class PerfCounters
+{
+public:
+  enum Stage : int
+  {
+    kOpen = 0,
+    kEventLoop,
+    kConversion,
+    kFit,
+    kRender,
+    kNStages
+  };
+  enum Counter : int
+  {
+    kCycles = 0,
+    kInstructions,
+    kCacheMisses,
+    kBranchMisses,
+    kNCounters
+  };
+
+  // false if the counters cannot be opened on the calling thread. totals
+  // of an earlier run of the process are cleared.
+  static bool enable();
+  static bool isEnabled()
+  {
+    return s_isEnabled.load(std::memory_order_relaxed);
+  }
+
+  // totals per stage and thread, and per stage over all threads. counting
+  // stops.
+  static bool write(const std::string& path);
+
+  static const char* const s_stageNames[kNStages];
+  static const char* const s_counterNames[kNCounters];
+
+private:
+  static std::atomic<bool> s_isEnabled;
+};
+
+class PerfScope
+{
+public:
+  explicit PerfScope(PerfCounters::Stage stage);
+  ~PerfScope();
+
+  PerfScope(const PerfScope& scope) = delete;
+  PerfScope& operator=(const PerfScope& scope) = delete;
+
+private:
+  const PerfCounters::Stage m_stage;
+  bool m_isActive;
+  uint64_t m_begin[PerfCounters::kNCounters + 2];
+};
+
+#endif // PERFCOUNTERS_HPP
@@ -0,0 +1,263 @@
+#ifndef PREVIEW_HPP
+#define PREVIEW_HPP
+
+// C++
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ROOT
+#include "ROOT/RDataFrame.hxx"
+#include "TTreeReader.h"
+
+/*
+ * quantiles of a stream with a bounded relative error (DDSketch).
+ * a positive value x is counted in bucket ceil(log_gamma(x)) with
+ * gamma = (1 + a) / (1 - a), and every value of a bucket is estimated by
+ * 2 gamma^i / (gamma + 1), within a relative error a of it. counts are
+ * integers, so sketches merge exactly in any order. energies and fractions
+ * are not negative; values up to 0 are counted as 0.
+ */
+class QuantileSketch
+{
+public:
+  explicit QuantileSketch(double relativeAccuracy = s_relativeAccuracy)
+    : m_gamma((1. + relativeAccuracy) / (1. - relativeAccuracy))
+    , m_logGamma(std::log(m_gamma))
+  {
+  }
+
+  void add(double value)
+  {
+    ++m_nEvents;
+    if (!(value > 0.)) {
+      ++m_nZeros;
+      return;
+    }
+    addCount(static_cast<int>(std::ceil(std::log(value) / m_logGamma)), 1);
+  }
+
+  void merge(const QuantileSketch& sketch)
+  {
+    m_nEvents += sketch.m_nEvents;
+    m_nZeros += sketch.m_nZeros;
+    for (size_t i = 0; i < sketch.m_counts.size(); ++i) {
+      if (sketch.m_counts[i] > 0) {
+        addCount(sketch.m_offset + static_cast<int>(i), sketch.m_counts[i]);
+      }
+    }
+  }
+
+  uint64_t size() const
+  {
+    return m_nEvents;
+  }
+
+  // value of rank q (nEvents - 1), q in [0, 1].
+  double quantile(double q) const
+  {
+    if (m_nEvents == 0) {
+      return std::nan("");
+    }
+    double rank = q * (m_nEvents - 1);
+    double below = m_nZeros;
+    if (rank < below) {
+      return 0.;
+    }
+    for (size_t i = 0; i < m_counts.size(); ++i) {
+      below += m_counts[i];
+      if (rank < below) {
+        return value(m_offset + static_cast<int>(i));
+      }
+    }
+    return value(m_offset + static_cast<int>(m_counts.size()) - 1);
+  }
+
+  // mean of the values between the quantiles trim and 1 - trim and the
+  // standard error of that mean from the winsorized variance.
+  std::pair<double, double> truncatedMean(double trim) const
+  {
+    const double n = m_nEvents;
+    const double low = trim * n;
+    const double high = (1. - trim) * n;
+    const double lowValue = quantile(trim);
+    const double highValue = quantile(1. - trim);
+    double weight = 0.;
+    double sum = 0.;
+    double winsorizedSum = 0.;
+    double winsorizedSum2 = 0.;
+
+    // walks the buckets in rank order; the zeros come first.
+    double begin = 0.;
+    auto addBucket = [&](double count, double bucketValue) {
+      double end = begin + count;
+      double inside = std::max(0., std::min(end, high) - std::max(begin, low));
+      weight += inside;
+      sum += inside * bucketValue;
+      double outsideLow = std::max(0., std::min(end, low) - begin);
+      double outsideHigh = std::max(0., end - std::max(begin, high));
+      double winsorized = inside * bucketValue + outsideLow * lowValue
+                          + outsideHigh * highValue;
+      winsorizedSum += winsorized;
+      winsorizedSum2 += inside * bucketValue * bucketValue
+                        + outsideLow * lowValue * lowValue
+                        + outsideHigh * highValue * highValue;
+      begin = end;
+    };
+    addBucket(m_nZeros, 0.);
+    for (size_t i = 0; i < m_counts.size(); ++i) {
+      addBucket(m_counts[i], value(m_offset + static_cast<int>(i)));
+    }
+    if (weight <= 0.) {
+      return { std::nan(""), std::nan("") };
+    }
+    double winsorizedMean = winsorizedSum / n;
+    double winsorizedVariance =
+      std::max(winsorizedSum2 / n - winsorizedMean * winsorizedMean, 0.);
+    return { sum / weight,
+             std::sqrt(winsorizedVariance / n) / (1. - 2. * trim) };
+  }
+
+  // 0.1 %, well below the fsam resolution of a cell.
+  static constexpr double s_relativeAccuracy = 0.001;
+
+private:
+  double value(int index) const
+  {
+    return 2. * std::pow(m_gamma, index) / (m_gamma + 1.);
+  }
+
+  void addCount(int index, uint64_t count)
+  {
+    if (m_counts.empty()) {
+      m_offset = index;
+    }
+    if (index < m_offset) {
+      // slack below, so a falling stream does not shift the counts often.
+      size_t grow = m_offset - index + s_slack;
+      m_counts.insert(m_counts.begin(), grow, 0);
+      m_offset -= static_cast<int>(grow);
+    }
+    size_t i = index - m_offset;
+    if (i >= m_counts.size()) {
+      m_counts.resize(i + 1 + s_slack, 0);
+    }
+    m_counts[i] += count;
+  }
+
+  static const size_t s_slack = 64;
+
+  double m_gamma;
+  double m_logGamma;
+  uint64_t m_nEvents = 0;
+  uint64_t m_nZeros = 0;
+  int m_offset = 0;
+  std::vector<uint64_t> m_counts;
+};
+
+// single pass estimators of one column of a cell for --preview.
+struct Preview
+{
+  uint64_t nEvents = 0;
+  double mean = 0.;
+  double stdDev = 0.;
+  double median = 0.;
+  double truncatedMean = 0.;
+  double truncatedMeanError = 0.;
+  // half the distance between the 15.87 % and 84.13 % quantiles, the sigma
+  // of a gaussian core.
+  double sigma = 0.;
+};
+
+/*
+ * RDataFrame action of --preview computing a Preview of one column in the
+ * cell's event loop, without histograms or fits. every slot keeps n, sum,
+ * sum of squares and a QuantileSketch; they are merged once in
+ * Finalize(). non finite values are skipped. with Sum = ExactSum the
+ * result does not depend on how events were spread over slots.
+ */
+template<typename Sum = double>
+class PreviewHelper : public ROOT::Detail::RDF::RActionImpl<PreviewHelper<Sum>>
+{
+public:
+  using Result_t = Preview;
+
+  explicit PreviewHelper(unsigned nSlots)
+    : m_partials(nSlots)
+    , m_result(std::make_shared<Preview>())
+  {
+  }
+  PreviewHelper(PreviewHelper&& helper) = default;
+  PreviewHelper(const PreviewHelper& helper) = delete;
+
+  std::shared_ptr<Result_t> GetResultPtr() const
+  {
+    return m_result;
+  }
+
+  void Initialize() {}
+  void InitTask(TTreeReader*, unsigned int) {}
+
+  void Exec(unsigned int slot, double value)
+  {
+    Partial& partial = m_partials[slot];
+
+    if (!std::isfinite(value)) {
+      return;
+    }
+    partial.sum += value;
+    partial.sum2 += value * value;
+    partial.sketch.add(value);
+  }
+
+  void Finalize()
+  {
+    Sum sum{};
+    Sum sum2{};
+    QuantileSketch sketch;
+
+    for (const auto& partial : m_partials) {
+      sum += partial.sum;
+      sum2 += partial.sum2;
+      sketch.merge(partial.sketch);
+    }
+    Preview& result = *m_result;
+    result.nEvents = sketch.size();
+    if (result.nEvents == 0) {
+      return;
+    }
+    double n = result.nEvents;
+    result.mean = double(sum) / n;
+    result.stdDev =
+      std::sqrt(std::max(double(sum2) / n - result.mean * result.mean, 0.));
+    result.median = sketch.quantile(0.5);
+    auto truncated = sketch.truncatedMean(s_trim);
+    result.truncatedMean = truncated.first;
+    result.truncatedMeanError = truncated.second;
+    result.sigma = (sketch.quantile(0.8413) - sketch.quantile(0.1587)) / 2.;
+  }
+
+  std::string GetActionName()
+  {
+    return "Preview";
+  }
+
+  // fraction cut from each side for the truncated mean.
+  static constexpr double s_trim = 0.1;
+
+private:
+  struct alignas(64) Partial
+  {
+    Sum sum{};
+    Sum sum2{};
+    QuantileSketch sketch;
+  };
+
+  std::vector<Partial> m_partials;
+  std::shared_ptr<Preview> m_result;
+};
+
+#endif // PREVIEW_HPP
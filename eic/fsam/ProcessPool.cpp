@@ -0,0 +1,220 @@
+// C++
+#include <cerrno>
+#include <chrono>
+#include <cstdio>
+#include <cstring>
+#include <thread>
+
+// POSIX
+#include <sys/wait.h>
+#include <unistd.h>
+
+#include <fmt/core.h>
+
+#include "Logger.hpp"
+#include "ProcessPool.hpp"
+
+const size_t ProcessPool::s_maxAttempts = 2;
+const unsigned ProcessPool::s_pollMs = 100;
+
+ProcessPool::ProcessPool(size_t nWorkers)
+  : m_nWorkers(nWorkers == 0 ? 1 : nWorkers)
+{
+}
+
+void
+ProcessPool::setForkHooks(
+  const std::function<void()>& prepare,
+  const std::function<void()>& parent)
+{
+  m_prepareFork = prepare;
+  m_parentAfterFork = parent;
+}
+
+void
+ProcessPool::run(
+  const std::vector<Cell>& cells,
+  const std::function<void(size_t)>& init,
+  const std::function<bool(const Cell&, size_t)>& work,
+  const std::function<void(const Cell&, size_t, bool)>& done)
+{
+  m_slots = SharedArray<Slot>(cells.size());
+  m_nAttempts.assign(cells.size(), 0);
+  std::vector<bool> isReported(cells.size(), false);
+
+  // finished cells are reported while the workers run.
+  auto report = [&]() {
+    for (size_t i = 0; i < cells.size(); ++i) {
+      int state = m_slots[i].state.load(std::memory_order_acquire);
+      if (isReported[i] == false && state < 0) {
+        isReported[i] = true;
+        done(cells[i], m_slots[i].worker.load(), state == kSucceeded);
+      }
+    }
+  };
+
+  Logger::info(
+    "running {} cells in {} worker processes", cells.size(), m_nWorkers);
+  for (size_t i = 0; i < m_nWorkers && i < cells.size(); ++i) {
+    spawn(i, cells, init, work);
+  }
+
+  // a worker that dies before it claims a cell gets no cell given up, so
+  // replacements are bounded separately.
+  size_t nRestarts = 0;
+  const size_t maxRestarts = cells.size() * s_maxAttempts + m_nWorkers;
+  while (m_workers.empty() == false) {
+    int status = 0;
+    pid_t pid = waitpid(-1, &status, WNOHANG);
+    if (pid == 0) {
+      report();
+      std::this_thread::sleep_for(std::chrono::milliseconds(s_pollMs));
+      continue;
+    }
+    if (pid < 0) {
+      if (errno == EINTR) {
+        continue;
+      }
+      Logger::error("waitpid: {}", std::strerror(errno));
+      break;
+    }
+    auto it = m_workers.find(pid);
+    if (it == m_workers.end()) {
+      continue;
+    }
+    size_t worker = it->second;
+    m_workers.erase(it);
+    if (WIFSIGNALED(status)) {
+      Logger::warning(
+        "worker {} (pid {}) killed by signal {}: {}",
+        worker,
+        pid,
+        WTERMSIG(status),
+        strsignal(WTERMSIG(status)));
+    } else if (WIFEXITED(status) && WEXITSTATUS(status) != 0) {
+      Logger::warning(
+        "worker {} (pid {}) exited with status {}",
+        worker,
+        pid,
+        WEXITSTATUS(status));
+    }
+    requeue(pid, cells);
+    if (hasPending() == false) {
+      continue;
+    }
+    if (nRestarts >= maxRestarts) {
+      Logger::error("workers keep dying, no more are started");
+      continue;
+    }
+    ++nRestarts;
+    spawn(worker, cells, init, work);
+  }
+
+  // cells no worker is left to run.
+  for (size_t i = 0; i < cells.size(); ++i) {
+    int state = m_slots[i].state.load();
+    if (state == kPending || state > 0) {
+      Logger::error("{} given up: no worker left", cells[i].simInfo);
+      m_slots[i].state.store(kGivenUp);
+    }
+  }
+  report();
+}
+
+pid_t
+ProcessPool::spawn(
+  size_t worker,
+  const std::vector<Cell>& cells,
+  const std::function<void(size_t)>& init,
+  const std::function<bool(const Cell&, size_t)>& work)
+{
+  // buffered output would be written again by the worker.
+  std::fflush(nullptr);
+  if (m_prepareFork) {
+    m_prepareFork();
+  }
+  pid_t pid = fork();
+  if (pid != 0 && m_parentAfterFork) {
+    m_parentAfterFork();
+  }
+  if (pid < 0) {
+    Logger::error("fork: {}", std::strerror(errno));
+    return pid;
+  }
+  if (pid == 0) {
+    int status = 0;
+    try {
+      init(worker);
+      runWorker(worker, cells, work);
+    } catch (const std::exception& e) {
+      Logger::error("worker {}: {}", worker, e.what());
+      status = 1;
+    }
+    // destructors would wait for threads of the supervisor that do not
+    // exist here.
+    Logger::flush();
+    std::fflush(nullptr);
+    _exit(status);
+  }
+  m_workers[pid] = worker;
+  Logger::debug("worker {} started as pid {}", worker, pid);
+  return pid;
+}
+
+void
+ProcessPool::runWorker(
+  size_t worker,
+  const std::vector<Cell>& cells,
+  const std::function<bool(const Cell&, size_t)>& work)
+{
+  const int self = getpid();
+
+  while (true) {
+    size_t i = 0;
+    int expected = kPending;
+    while (i < cells.size()
+           && m_slots[i].state.compare_exchange_strong(expected, self) == false) {
+      expected = kPending;
+      ++i;
+    }
+    if (i == cells.size()) {
+      return;
+    }
+    m_slots[i].worker.store(worker, std::memory_order_relaxed);
+    bool isSucceeded = work(cells[i], worker);
+    m_slots[i].state.store(
+      isSucceeded ? kSucceeded : kFailed, std::memory_order_release);
+  }
+}
+
+// cells still owned by a dead worker.
+void
+ProcessPool::requeue(pid_t pid, const std::vector<Cell>& cells)
+{
+  for (size_t i = 0; i < cells.size(); ++i) {
+    if (m_slots[i].state.load() != pid) {
+      continue;
+    }
+    if (++m_nAttempts[i] >= s_maxAttempts) {
+      Logger::error(
+        "{} given up after {} workers died on it",
+        cells[i].simInfo,
+        m_nAttempts[i]);
+      m_slots[i].state.store(kGivenUp);
+    } else {
+      Logger::warning("{} requeued", cells[i].simInfo);
+      m_slots[i].state.store(kPending);
+    }
+  }
+}
+
+bool
+ProcessPool::hasPending() const
+{
+  for (const auto& slot : m_slots) {
+    if (slot.state.load() == kPending) {
+      return true;
+    }
+  }
+  return false;
+}
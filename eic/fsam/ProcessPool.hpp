@@ -0,0 +1,101 @@
+#ifndef PROCESSPOOL_HPP
+#define PROCESSPOOL_HPP
+
+// C++
+#include <atomic>
+#include <functional>
+#include <map>
+#include <vector>
+
+// POSIX
+#include <sys/types.h>
+
+#include "CellScheduler.hpp"
+#include "SharedArray.hpp"
+
+/*
+ * runs cells in forked worker processes (--processes), so cells share no
+ * ROOT global state, locks or heap, and a crashing cell takes down only its
+ * worker. the queue lives in shared memory: a worker claims the next
+ * pending cell by writing its pid into the cell's slot. the supervisor
+ * reaps workers, puts the cells of a worker that died back in the queue
+ * and forks a replacement. a cell that has killed s_maxAttempts workers is
+ * given up. results reach the supervisor only through shared memory, see
+ * SharedArray.
+ *
+ * workers are forked from the calling thread; every other thread of the
+ * supervisor is absent in them, so no lock may be taken that such a
+ * thread could hold. the Logger handles this itself; other threads of the
+ * supervisor are stopped around each fork by the fork hooks.
+ */
+class ProcessPool
+{
+public:
+  explicit ProcessPool(size_t nWorkers);
+  ~ProcessPool() = default;
+
+  ProcessPool(const ProcessPool& pool) = delete;
+  ProcessPool& operator=(const ProcessPool& pool) = delete;
+
+  // prepare runs in the supervisor before every fork(), parent after it.
+  void setForkHooks(
+    const std::function<void()>& prepare,
+    const std::function<void()>& parent);
+
+  // init runs once in every new worker process with the worker index.
+  // work runs in the workers and returns whether the cell succeeded. done
+  // runs in the supervisor for every finished or given up cell, with the
+  // index of the worker that ran it last.
+  void run(
+    const std::vector<Cell>& cells,
+    const std::function<void(size_t)>& init,
+    const std::function<bool(const Cell&, size_t)>& work,
+    const std::function<void(const Cell&, size_t, bool)>& done);
+
+  static const size_t s_maxAttempts;
+
+private:
+  // state of a cell: its owner's pid while running, else one of these.
+  enum State : int
+  {
+    kPending = 0,
+    kSucceeded = -1,
+    kFailed = -2,
+    kGivenUp = -3
+  };
+
+  struct Slot
+  {
+    std::atomic<int> state;
+    std::atomic<size_t> worker;
+  };
+  static_assert(
+    std::atomic<int>::is_always_lock_free
+      && std::atomic<size_t>::is_always_lock_free,
+    "queue slots are shared between processes");
+
+  pid_t spawn(
+    size_t worker,
+    const std::vector<Cell>& cells,
+    const std::function<void(size_t)>& init,
+    const std::function<bool(const Cell&, size_t)>& work);
+  void runWorker(
+    size_t worker,
+    const std::vector<Cell>& cells,
+    const std::function<bool(const Cell&, size_t)>& work);
+  void requeue(pid_t pid, const std::vector<Cell>& cells);
+  bool hasPending() const;
+
+private:
+  const size_t m_nWorkers;
+  SharedArray<Slot> m_slots;
+  // attempts per cell, supervisor only.
+  std::vector<size_t> m_nAttempts;
+  std::map<pid_t, size_t> m_workers;
+  std::function<void()> m_prepareFork;
+  std::function<void()> m_parentAfterFork;
+
+  static const unsigned s_pollMs;
+};
+
+#endif // PROCESSPOOL_HPP
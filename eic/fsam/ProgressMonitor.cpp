@@ -0,0 +1,169 @@
+// C++
+#include <cstdio>
+#include <fstream>
+
+#include <fmt/core.h>
+
+#include "Logger.hpp"
+#include "ProgressMonitor.hpp"
+
+ProgressMonitor::ProgressMonitor(
+  const std::string& path,
+  size_t nCells,
+  size_t nEvents,
+  size_t nWorkers,
+  unsigned periodMs)
+  : m_path(path)
+  , m_nCells(nCells)
+  , m_nEvents(nEvents)
+  , m_workers(std::make_unique<WorkerCounter[]>(nWorkers))
+  , m_nWorkers(nWorkers)
+  , m_nDone(0)
+  , m_nRunning(0)
+  , m_nFailed(0)
+  , m_start(std::chrono::steady_clock::now())
+  , m_periodMs(periodMs)
+  , m_isStopped(false)
+{
+  if (m_path.empty() == false) {
+    m_sampler = std::thread(&ProgressMonitor::sample, this);
+  }
+}
+
+ProgressMonitor::~ProgressMonitor()
+{
+  if (m_sampler.joinable() == false) {
+    return;
+  }
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopped = true;
+  }
+  m_cv.notify_all();
+  m_sampler.join();
+}
+
+void
+ProgressMonitor::beginCell()
+{
+  ++m_nRunning;
+}
+
+void
+ProgressMonitor::endCell(size_t worker, bool isSucceeded)
+{
+  ++m_workers[worker].nCellsDone;
+  ++m_nDone;
+  if (isSucceeded == false) {
+    ++m_nFailed;
+  }
+  --m_nRunning;
+}
+
+void
+ProgressMonitor::addEvents(size_t worker, size_t nEvents)
+{
+  m_workers[worker].nEvents.fetch_add(nEvents, std::memory_order_relaxed);
+}
+
+void
+ProgressMonitor::pause()
+{
+  m_mutex.lock();
+}
+
+void
+ProgressMonitor::resume()
+{
+  m_mutex.unlock();
+}
+
+void
+ProgressMonitor::sample()
+{
+  std::unique_lock<std::mutex> lock(m_mutex);
+  auto last = m_start;
+
+  // the last write after stopping leaves the final counters in the file.
+  while (true) {
+    bool isStopped = m_cv.wait_for(
+      lock, std::chrono::milliseconds(m_periodMs), [this]() {
+        return m_isStopped;
+      });
+    auto now = std::chrono::steady_clock::now();
+    write(
+      std::chrono::duration<double>(now - m_start).count(),
+      std::chrono::duration<double>(now - last).count());
+    last = now;
+    if (isStopped == true) {
+      return;
+    }
+  }
+}
+
+// rewritten through a temporary file so readers never see a partial file.
+void
+ProgressMonitor::write(double elapsed, double interval)
+{
+  size_t nEvents = 0;
+  for (size_t i = 0; i < m_nWorkers; ++i) {
+    WorkerCounter& worker = m_workers[i];
+    size_t events = worker.nEvents.load(std::memory_order_relaxed);
+    worker.rate = interval > 0. ? (events - worker.lastEvents) / interval : 0.;
+    worker.lastEvents = events;
+    nEvents += events;
+  }
+  double rate = elapsed > 0. ? nEvents / elapsed : 0.;
+  double remaining = -1.;
+  if (rate > 0. && m_nEvents >= nEvents) {
+    remaining = (m_nEvents - nEvents) / rate;
+  }
+
+  std::string tmpPath = m_path + ".tmp";
+  std::ofstream ofs(tmpPath);
+  ofs << "# HELP fsam_cells Cells of the energy and eta grid by state.\n"
+      << "# TYPE fsam_cells gauge\n"
+      << fmt::format("fsam_cells{{state=\"total\"}} {}\n", m_nCells)
+      << fmt::format("fsam_cells{{state=\"done\"}} {}\n", m_nDone.load())
+      << fmt::format("fsam_cells{{state=\"running\"}} {}\n", m_nRunning.load())
+      << fmt::format("fsam_cells{{state=\"failed\"}} {}\n", m_nFailed.load())
+      << "# HELP fsam_events_total Events read by the first event loop of "
+         "each cell, before any cut.\n"
+      << "# TYPE fsam_events_total counter\n"
+      << fmt::format("fsam_events_total {}\n", nEvents)
+      << "# HELP fsam_events_expected Entries of the input files of all "
+         "cells.\n"
+      << "# TYPE fsam_events_expected gauge\n"
+      << fmt::format("fsam_events_expected {}\n", m_nEvents)
+      << "# HELP fsam_events_per_second Average rate since start.\n"
+      << "# TYPE fsam_events_per_second gauge\n"
+      << fmt::format("fsam_events_per_second {:.1f}\n", rate)
+      << "# HELP fsam_worker_events_per_second Rate of each worker in the "
+         "last period.\n"
+      << "# TYPE fsam_worker_events_per_second gauge\n";
+  for (size_t i = 0; i < m_nWorkers; ++i) {
+    ofs << fmt::format(
+      "fsam_worker_events_per_second{{worker=\"{}\"}} {:.1f}\n",
+      i,
+      m_workers[i].rate);
+  }
+  ofs << "# HELP fsam_worker_cells_done Cells finished by each worker.\n"
+      << "# TYPE fsam_worker_cells_done counter\n";
+  for (size_t i = 0; i < m_nWorkers; ++i) {
+    ofs << fmt::format(
+      "fsam_worker_cells_done{{worker=\"{}\"}} {}\n",
+      i,
+      m_workers[i].nCellsDone.load());
+  }
+  ofs << "# HELP fsam_elapsed_seconds Wall time since the run started.\n"
+      << "# TYPE fsam_elapsed_seconds gauge\n"
+      << fmt::format("fsam_elapsed_seconds {:.1f}\n", elapsed)
+      << "# HELP fsam_remaining_seconds Estimate from the average rate, "
+         "-1 if unknown.\n"
+      << "# TYPE fsam_remaining_seconds gauge\n"
+      << fmt::format("fsam_remaining_seconds {:.1f}\n", remaining);
+  ofs.close();
+  if (!ofs || std::rename(tmpPath.c_str(), m_path.c_str()) != 0) {
+    Logger::error("cannot write progress file {}", m_path);
+  }
+}
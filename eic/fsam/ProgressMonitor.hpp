@@ -0,0 +1,76 @@
+#ifndef PROGRESSMONITOR_HPP
+#define PROGRESSMONITOR_HPP
+
+// C++
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+
+/*
+ * live counters of a HistManager run.
+ * workers report cells and processed events; a background thread rewrites
+ * a Prometheus text file every period so running jobs can be watched with
+ * 'cat' or scraped by node_exporter's textfile collector.
+ * counters are atomics, so reporting never blocks the event loop.
+ */
+class ProgressMonitor
+{
+public:
+  // empty path keeps the counters but writes nothing.
+  ProgressMonitor(
+    const std::string& path,
+    size_t nCells,
+    size_t nEvents,
+    size_t nWorkers,
+    unsigned periodMs = 5000);
+  ~ProgressMonitor();
+
+  ProgressMonitor(const ProgressMonitor& monitor) = delete;
+  ProgressMonitor& operator=(const ProgressMonitor& monitor) = delete;
+
+  void beginCell();
+  void endCell(size_t worker, bool isSucceeded);
+  // called from RDataFrame partial result callbacks of the worker's cell.
+  void addEvents(size_t worker, size_t nEvents);
+  // holds the sampler between two samples, e.g. across fork(); counters
+  // may still be reported while it is held.
+  void pause();
+  void resume();
+
+private:
+  void sample();
+  void write(double elapsed, double interval);
+
+private:
+  // one cache line per worker so workers do not share counters.
+  struct alignas(64) WorkerCounter
+  {
+    std::atomic<size_t> nEvents{ 0 };
+    std::atomic<size_t> nCellsDone{ 0 };
+    size_t lastEvents = 0;
+    double rate = 0.;
+  };
+
+  const std::string m_path;
+  const size_t m_nCells;
+  const size_t m_nEvents;
+  std::unique_ptr<WorkerCounter[]> m_workers;
+  const size_t m_nWorkers;
+  std::atomic<size_t> m_nDone;
+  std::atomic<size_t> m_nRunning;
+  std::atomic<size_t> m_nFailed;
+  const std::chrono::steady_clock::time_point m_start;
+
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  std::thread m_sampler;
+  unsigned m_periodMs;
+  bool m_isStopped;
+};
+
+#endif // PROGRESSMONITOR_HPP
@@ -0,0 +1,226 @@
+// C++
+#include <cmath>
+
+// ROOT
+#include "TDirectory.h"
+#include "TF1.h"
+#include "TFile.h"
+#include "TGraph2DErrors.h"
+#include "TGraphErrors.h"
+#include "TTree.h"
+
+#include <fmt/core.h>
+
+#include "ConcurrentFit.hpp"
+#include "Logger.hpp"
+#include "Resolution.hpp"
+
+namespace
+{
+
+double
+resolutionFunction(double* x, double* p)
+{
+  return std::sqrt(p[0] * p[0] / x[0] + p[1] * p[1] / (x[0] * x[0]) + p[2] * p[2]);
+}
+
+double
+linearFunction(double* x, double* p)
+{
+  return p[0] * x[0] + p[1];
+}
+
+// sigma / mean and its error.
+std::pair<double, double>
+relativeWidth(const CellFit& cell)
+{
+  double ratio = cell.sigma / cell.mean;
+  double error = ratio
+                 * std::hypot(cell.sigmaError / cell.sigma,
+                              cell.meanError / cell.mean);
+  return { ratio, error };
+}
+
+} // namespace
+
+Resolution::Resolution(
+  const std::vector<double>& energies,
+  const std::vector<double>& etas,
+  const std::vector<CellFit>& cells)
+  : m_energies(energies)
+  , m_etas(etas)
+  , m_cells(cells)
+{
+}
+
+std::vector<ResolutionRow>
+Resolution::fit(ROOT::TThreadExecutor& executor) const
+{
+  return executor.Map(
+    [this](unsigned j) { return fitRow(j); }, ROOT::TSeqU(m_etas.size()));
+}
+
+ResolutionRow
+Resolution::fitRow(size_t etaBin) const
+{
+  // detached from any directory so threads do not share a list.
+  TDirectory::TContext context(nullptr);
+  ResolutionRow row;
+  TGraphErrors resolutionGraph;
+  TGraphErrors linearityGraph;
+  double minEnergy = 0.;
+  double maxEnergy = 0.;
+
+  row.eta = m_etas[etaBin];
+  for (size_t i = 0; i < m_energies.size(); ++i) {
+    const CellFit& cell = at(i, etaBin);
+    if (isValid(cell) == false) {
+      continue;
+    }
+    auto [ratio, ratioError] = relativeWidth(cell);
+    int n = resolutionGraph.GetN();
+    resolutionGraph.SetPoint(n, m_energies[i], ratio);
+    resolutionGraph.SetPointError(n, 0., ratioError);
+    linearityGraph.SetPoint(n, m_energies[i], cell.mean);
+    linearityGraph.SetPointError(n, 0., cell.meanError);
+    minEnergy = n == 0 ? m_energies[i] : std::min(minEnergy, m_energies[i]);
+    maxEnergy = std::max(maxEnergy, m_energies[i]);
+  }
+
+  if (resolutionGraph.GetN() >= 3) {
+    TF1 function(
+      "resolution",
+      resolutionFunction,
+      minEnergy,
+      maxEnergy,
+      3,
+      1,
+      TF1::EAddToList::kNo);
+    function.SetParameters(0.05, 0.01, 0.01);
+    row.resolutionStatus =
+      concurrentFit(resolutionGraph, function, "QN0", minEnergy, maxEnergy);
+    row.stochastic = std::abs(function.GetParameter(0));
+    row.stochasticError = function.GetParError(0);
+    row.noise = std::abs(function.GetParameter(1));
+    row.noiseError = function.GetParError(1);
+    row.constant = std::abs(function.GetParameter(2));
+    row.constantError = function.GetParError(2);
+    row.resolutionChi2 = function.GetChisquare();
+    row.resolutionNdf = function.GetNDF();
+  }
+  if (linearityGraph.GetN() >= 2) {
+    TF1 function(
+      "linearity",
+      linearFunction,
+      minEnergy,
+      maxEnergy,
+      2,
+      1,
+      TF1::EAddToList::kNo);
+    function.SetParameters(1., 0.);
+    row.linearityStatus =
+      concurrentFit(linearityGraph, function, "QN0", minEnergy, maxEnergy);
+    row.slope = function.GetParameter(0);
+    row.slopeError = function.GetParError(0);
+    row.offset = function.GetParameter(1);
+    row.offsetError = function.GetParError(1);
+    row.linearityChi2 = function.GetChisquare();
+    row.linearityNdf = function.GetNDF();
+  }
+  Logger::debug(
+    "eta {}: stochastic {:.4f}, noise {:.4f}, constant {:.4f}, slope {:.4f}",
+    row.eta,
+    row.stochastic,
+    row.noise,
+    row.constant,
+    row.slope);
+  return row;
+}
+
+void
+Resolution::write(
+  const std::string& pathPrefix,
+  const std::vector<ResolutionRow>& rows) const
+{
+  std::string path = fmt::format("{}resolution.root", pathPrefix);
+  TFile* file = TFile::Open(path.c_str(), "CREATE");
+
+  if (file == nullptr || file->IsOpen() == kFALSE) {
+    Logger::error("cannot open file {}", path);
+    delete file;
+    return;
+  }
+
+  // scoped so the tree is gone before Close() deletes the file contents.
+  {
+    TTree tree("resolution", "resolution and linearity fits per eta bin");
+    ResolutionRow row;
+    tree.Branch("eta", &row.eta);
+    tree.Branch("stochastic", &row.stochastic);
+    tree.Branch("stochasticError", &row.stochasticError);
+    tree.Branch("noise", &row.noise);
+    tree.Branch("noiseError", &row.noiseError);
+    tree.Branch("constant", &row.constant);
+    tree.Branch("constantError", &row.constantError);
+    tree.Branch("resolutionChi2", &row.resolutionChi2);
+    tree.Branch("resolutionNdf", &row.resolutionNdf);
+    tree.Branch("resolutionStatus", &row.resolutionStatus);
+    tree.Branch("slope", &row.slope);
+    tree.Branch("slopeError", &row.slopeError);
+    tree.Branch("offset", &row.offset);
+    tree.Branch("offsetError", &row.offsetError);
+    tree.Branch("linearityChi2", &row.linearityChi2);
+    tree.Branch("linearityNdf", &row.linearityNdf);
+    tree.Branch("linearityStatus", &row.linearityStatus);
+    for (const auto& fitted : rows) {
+      row = fitted;
+      tree.Fill();
+    }
+    tree.Write();
+  }
+
+  // graphs of every row, named after the eta bin center.
+  TGraph2DErrors* graph = new TGraph2DErrors();
+  for (size_t j = 0; j < m_etas.size(); ++j) {
+    TGraphErrors resolutionGraph;
+    TGraphErrors linearityGraph;
+    for (size_t i = 0; i < m_energies.size(); ++i) {
+      const CellFit& cell = at(i, j);
+      if (isValid(cell) == false) {
+        continue;
+      }
+      auto [ratio, ratioError] = relativeWidth(cell);
+      int n = resolutionGraph.GetN();
+      resolutionGraph.SetPoint(n, m_energies[i], ratio);
+      resolutionGraph.SetPointError(n, 0., ratioError);
+      linearityGraph.SetPoint(n, m_energies[i], cell.mean);
+      linearityGraph.SetPointError(n, 0., cell.meanError);
+      int point = graph->GetN();
+      graph->SetPoint(point, m_etas[j], m_energies[i], ratio);
+      graph->SetPointError(point, 0., 0., ratioError);
+    }
+    resolutionGraph.SetTitle("; Energy [GeV]; #sigma / mean");
+    linearityGraph.SetTitle("; Energy [GeV]; Mean");
+    resolutionGraph.Write(fmt::format("resolution_eta{}", m_etas[j]).c_str());
+    linearityGraph.Write(fmt::format("linearity_eta{}", m_etas[j]).c_str());
+  }
+  file->Close();
+  delete file;
+
+  graph->SetTitle("; Eta; Energy; #sigma / mean");
+  graph->SaveAs(fmt::format("{}resolution2Dgraph.root", pathPrefix).c_str());
+  delete graph;
+  Logger::info("resolution fits are written to {}", path);
+}
+
+const CellFit&
+Resolution::at(size_t energyBin, size_t etaBin) const
+{
+  return m_cells[energyBin * m_etas.size() + etaBin];
+}
+
+bool
+Resolution::isValid(const CellFit& cell) const
+{
+  return cell.mean > 0. && cell.sigma > 0.;
+}
@@ -0,0 +1,85 @@
+#ifndef RESOLUTION_HPP
+#define RESOLUTION_HPP
+
+// C++
+#include <string>
+#include <vector>
+
+// ROOT
+#include "ROOT/TThreadExecutor.hxx"
+
+// gaussian mean and width of one (energy, eta) cell.
+struct CellFit
+{
+  double mean = 0.;
+  double meanError = 0.;
+  double sigma = 0.;
+  double sigmaError = 0.;
+};
+
+/*
+ * fitted parameters of one eta row.
+ * resolution: sigma / mean = sqrt(stochastic^2 / E + noise^2 / E^2
+ *                                 + constant^2), E generated energy in GeV.
+ * linearity: mean = slope * E + offset.
+ * status is the TFitResult status, -1 if the row has too few cells.
+ */
+struct ResolutionRow
+{
+  double eta = 0.;
+  double stochastic = 0.;
+  double stochasticError = 0.;
+  double noise = 0.;
+  double noiseError = 0.;
+  double constant = 0.;
+  double constantError = 0.;
+  double resolutionChi2 = 0.;
+  int resolutionNdf = 0;
+  int resolutionStatus = -1;
+  double slope = 0.;
+  double slopeError = 0.;
+  double offset = 0.;
+  double offsetError = 0.;
+  double linearityChi2 = 0.;
+  int linearityNdf = 0;
+  int linearityStatus = -1;
+};
+
+/*
+ * resolution and linearity fits of every eta row of the grid.
+ * rows are independent and fitted as one batch of executor tasks.
+ * cells with a failed gaussian fit (mean or sigma <= 0) are skipped.
+ */
+class Resolution
+{
+public:
+  // cells are energy major like the grid of HistManager.
+  Resolution(
+    const std::vector<double>& energies,
+    const std::vector<double>& etas,
+    const std::vector<CellFit>& cells);
+  ~Resolution() = default;
+  Resolution(const Resolution& resolution) = delete;
+  Resolution& operator=(const Resolution& resolution) = delete;
+
+  // eta rows are fitted concurrently, see ConcurrentFit.
+  std::vector<ResolutionRow> fit(ROOT::TThreadExecutor& executor) const;
+
+  // resolution.root: 'resolution' tree with a row per eta bin and the graphs
+  // of every row. resolution2Dgraph.root: sigma / mean over (eta, energy).
+  void write(
+    const std::string& pathPrefix,
+    const std::vector<ResolutionRow>& rows) const;
+
+private:
+  ResolutionRow fitRow(size_t etaBin) const;
+  const CellFit& at(size_t energyBin, size_t etaBin) const;
+  bool isValid(const CellFit& cell) const;
+
+private:
+  const std::vector<double> m_energies;
+  const std::vector<double> m_etas;
+  const std::vector<CellFit> m_cells;
+};
+
+#endif // RESOLUTION_HPP
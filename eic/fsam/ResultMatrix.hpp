@@ -0,0 +1,90 @@
+#ifndef RESULTMATRIX_HPP
+#define RESULTMATRIX_HPP
+
+// C++
+#include <algorithm>
+#include <limits>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include "SharedArray.hpp"
+
+/*
+ * fitted mean and error of every result column on the (energy, eta) grid.
+ * every column is allocated once, energy major, and a cell only writes its
+ * own slots, so cell workers store their results without a lock. graphs
+ * and histograms are built from it after the cells are done. slots never
+ * written are not set and read as NaN. the slots are shared memory, so
+ * cells run by forked worker processes write them too.
+ */
+class ResultMatrix
+{
+public:
+  struct Entry
+  {
+    double value = std::numeric_limits<double>::quiet_NaN();
+    double error = std::numeric_limits<double>::quiet_NaN();
+    bool isSet = false;
+  };
+
+  ResultMatrix() = default;
+  ResultMatrix(size_t nEnergy, size_t nEta, std::vector<std::string> columns)
+    : m_nEta(nEta)
+    , m_nCells(nEnergy * nEta)
+    , m_columns(std::move(columns))
+    , m_entries(m_columns.size() * m_nCells)
+  {
+  }
+
+  bool hasColumn(const std::string& columnName) const
+  {
+    return std::find(m_columns.begin(), m_columns.end(), columnName)
+           != m_columns.end();
+  }
+
+  const std::vector<std::string>& columns() const
+  {
+    return m_columns;
+  }
+
+  size_t nCells() const
+  {
+    return m_nCells;
+  }
+
+  // the cell's slot of a column; no other cell touches it.
+  void set(
+    const std::string& columnName,
+    size_t energyBin,
+    size_t etaBin,
+    const std::pair<double, double>& mean)
+  {
+    m_entries[index(columnName) + energyBin * m_nEta + etaBin] =
+      Entry{ mean.first, mean.second, true };
+  }
+
+  const Entry& at(const std::string& columnName, size_t cell) const
+  {
+    return m_entries[index(columnName) + cell];
+  }
+
+private:
+  size_t index(const std::string& columnName) const
+  {
+    auto it = std::find(m_columns.begin(), m_columns.end(), columnName);
+    if (it == m_columns.end()) {
+      throw std::out_of_range("no result column " + columnName);
+    }
+    return (it - m_columns.begin()) * m_nCells;
+  }
+
+private:
+  size_t m_nEta = 0;
+  size_t m_nCells = 0;
+  std::vector<std::string> m_columns;
+  SharedArray<Entry> m_entries;
+};
+
+#endif // RESULTMATRIX_HPP
@@ -0,0 +1,92 @@
+#ifndef RUNOPTIONS_HPP
+#define RUNOPTIONS_HPP
+
+#include <string>
+#include <vector>
+
+#include "ExportTable.hpp"
+#include "FsamTable.hpp"
+
+// binning of the shower profiles.
+// layer is decoded from cellID bits [layerOffset, layerOffset + layerWidth),
+// radial depth is sqrt(x^2 + y^2) of the hit position in mm.
+struct ProfileBinning
+{
+  unsigned layerOffset = 14;
+  unsigned layerWidth = 6;
+  size_t nRadialBins = 40;
+  double radialMin = 750.;
+  double radialMax = 1250.;
+
+  size_t nLayers() const
+  {
+    return size_t(1) << layerWidth;
+  };
+};
+
+/*
+ * command line options shared by fsam modes.
+ * every option has a default that keeps the original behavior.
+ */
+struct RunOptions
+{
+  // getFsam batch manifest. empty means single pair mode.
+  std::string batchManifest;
+  // number of worker threads. 0 means number of cores for getFsam batch
+  // and number of energy bins for HistManager.
+  size_t nJobs = 0;
+  // threads shared by concurrent cells, the implicit MT event loops inside
+  // them and the bootstrap, fit ladder and resolution fits. 0 keeps one
+  // single threaded event loop per cell worker.
+  size_t nThreads = 0;
+  // forked worker processes running the cells of HistManager, each with
+  // nThreads implicit MT threads of its own. 0 runs the cells on threads of
+  // this process.
+  size_t nProcesses = 0;
+  // memory budget of concurrently running cells in MB. 0 means no limit.
+  size_t memoryBudgetMB = 0;
+  // relative error on the mean of fsam (simEnergy for sensitive runs) at
+  // which a cell stops reading events. 0 reads every event.
+  double targetPrecision = 0.;
+  // mean, sketch median, truncated mean and std dev of every column in one
+  // pass per cell, without histograms, fits or drawing, written to preview/.
+  bool isPreview = false;
+  // bootstrap replicas per cell and column. 0 disables the bootstrap.
+  size_t nBootstrap = 0;
+  // also fit the Imaging layers and the whole barrel (ScFi + Imaging).
+  bool isImaging = false;
+  // fit every cell with the strategies of FitLadder and keep the best.
+  bool isFitLadder = false;
+  // RDataFrame JIT compilations and time to the first event of every cell
+  // written to startup.tsv.
+  bool isStartupReport = false;
+  // cycles, instructions, cache and branch misses per stage and thread
+  // written to perfCounters.tsv, see PerfCounters.hpp.
+  bool isPerfCounters = false;
+  // per layer and radial energy sums written to profiles.root.
+  bool isProfiling = false;
+  ProfileBinning profileBinning;
+  // policy of the exported fsamTable.bin.
+  FsamTable::Interpolation lutInterpolation = FsamTable::kBilinear;
+  FsamTable::Extrapolation lutExtrapolation = FsamTable::kClamp;
+  unsigned lutSmooth = 0;
+  // measured fsam table applied per event for the closure fit.
+  // empty disables the closure.
+  std::string fsamTablePath;
+  // exact, order independent sums and histogram statistics so results are
+  // bit identical for any thread count and schedule.
+  bool isReproducible = false;
+  // event selection config, see Selection.hpp. empty keeps every event.
+  std::string selectionPath;
+  // Prometheus text file rewritten with live counters. empty disables it.
+  std::string progressPath;
+  // hit energy thresholds in GeV of the recEnergy and fsam scan, increasing.
+  // empty disables the scan.
+  std::vector<double> hitThresholds;
+  // Arrow IPC or Parquet copy of the per cell results. kNone disables it.
+  ExportTable::Format exportFormat = ExportTable::kNone;
+  // also export genEnergy and the fitted columns of every event.
+  bool isExportingEvents = false;
+};
+
+#endif // RUNOPTIONS_HPP
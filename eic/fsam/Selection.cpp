@@ -0,0 +1,123 @@
+// C++
+#include <cmath>
+#include <fstream>
+#include <sstream>
+
+// EDM
+#include "edm4eic/CalorimeterHitCollectionData.h"
+#include "edm4eic/ReconstructedParticleCollectionData.h"
+#include "edm4hep/SimCalorimeterHitData.h"
+
+#include "Logger.hpp"
+#include "Selection.hpp"
+
+using RecHits = std::vector<edm4eic::CalorimeterHitData>;
+using SimHits = std::vector<edm4hep::SimCalorimeterHitData>;
+using Particles = std::vector<edm4eic::ReconstructedParticleData>;
+
+bool
+Selection::read(const std::string& path)
+{
+  std::ifstream ifs(path);
+  std::string line;
+  size_t lineNumber = 0;
+
+  if (!ifs) {
+    Logger::error("cannot open selection {}", path);
+    return false;
+  }
+  while (std::getline(ifs, line)) {
+    ++lineNumber;
+    line = line.substr(0, line.find('#'));
+    std::stringstream ss(line);
+    std::string key;
+    std::string value;
+    if (!(ss >> key)) {
+      continue;
+    }
+    ss >> value;
+
+    std::stringstream valueStream(value);
+    bool isValid = true;
+    if (key == "singleParticle") {
+      isValid = value == "true" || value == "false";
+      m_isSingleParticle = value == "true";
+    } else if (key == "minRecHits") {
+      isValid = static_cast<bool>(valueStream >> m_minRecHits);
+    } else if (key == "maxRecHits") {
+      isValid = static_cast<bool>(valueStream >> m_maxRecHits);
+    } else if (key == "minSimHits") {
+      isValid = static_cast<bool>(valueStream >> m_minSimHits);
+    } else if (key == "containment") {
+      char colon1 = 0;
+      char colon2 = 0;
+      valueStream >> m_containmentRMin >> colon1 >> m_containmentRMax >> colon2
+        >> m_minContainment;
+      isValid = !valueStream.fail() && colon1 == ':' && colon2 == ':'
+                && m_containmentRMax > m_containmentRMin;
+    } else {
+      isValid = false;
+    }
+    if (isValid == false) {
+      Logger::error("{}:{}: invalid selection '{}'", path, lineNumber, line);
+      return false;
+    }
+  }
+  return true;
+}
+
+bool
+Selection::isEmpty() const
+{
+  return m_isSingleParticle == false && m_minRecHits == 0
+         && m_maxRecHits == 0 && m_minSimHits == 0 && m_minContainment <= 0.;
+}
+
+// cheaper cuts come first so later ones see fewer events.
+ROOT::RDF::RNode
+Selection::apply(ROOT::RDF::RNode dataNode, bool isSensitive) const
+{
+  if (m_isSingleParticle == true) {
+    dataNode = dataNode.Filter(
+      [](const Particles& particles) { return particles.size() == 1; },
+      { "GeneratedParticles" },
+      "singleParticle");
+  }
+  if (m_minRecHits > 0 || m_maxRecHits > 0) {
+    const size_t minHits = m_minRecHits;
+    const size_t maxHits = m_maxRecHits;
+    dataNode = dataNode.Filter(
+      [minHits, maxHits](const RecHits& hits) {
+        return hits.size() >= minHits
+               && (maxHits == 0 || hits.size() <= maxHits);
+      },
+      { "EcalBarrelScFiRecHits" },
+      fmt::format("recHits[{}, {}]", minHits, maxHits));
+  }
+  if (m_minSimHits > 0 && isSensitive == true) {
+    const size_t minHits = m_minSimHits;
+    dataNode = dataNode.Filter(
+      [minHits](const SimHits& hits) { return hits.size() >= minHits; },
+      { "EcalBarrelScFiHits" },
+      fmt::format("simHits>={}", minHits));
+  }
+  if (m_minContainment > 0.) {
+    const double rMin = m_containmentRMin;
+    const double rMax = m_containmentRMax;
+    const double minFraction = m_minContainment;
+    dataNode = dataNode.Filter(
+      [rMin, rMax, minFraction](const RecHits& hits) {
+        double sum = 0.;
+        double contained = 0.;
+        for (const auto& hit : hits) {
+          double r = std::hypot(hit.position.x, hit.position.y);
+          sum += hit.energy;
+          contained += (r >= rMin && r <= rMax) ? hit.energy : 0.;
+        }
+        return sum > 0. && contained >= minFraction * sum;
+      },
+      { "EcalBarrelScFiRecHits" },
+      fmt::format("containment[{}, {}]>={}", rMin, rMax, minFraction));
+  }
+  return dataNode;
+}
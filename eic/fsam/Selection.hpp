@@ -0,0 +1,55 @@
+#ifndef SELECTION_HPP
+#define SELECTION_HPP
+
+// C++
+#include <string>
+#include <vector>
+
+// ROOT
+#include "ROOT/RDataFrame.hxx"
+
+/*
+ * event selection read from a config file of 'KEY VALUE' lines.
+ * '#' starts a comment. every key is optional; a missing key is no cut.
+ *
+ *   singleParticle  true|false   exactly one GeneratedParticles entry
+ *   minRecHits      N            at least N EcalBarrelScFiRecHits
+ *   maxRecHits      N            at most N EcalBarrelScFiRecHits
+ *   minSimHits      N            at least N EcalBarrelScFiHits (sensitive)
+ *   containment     RMIN:RMAX:F  at least fraction F of the rec hit energy
+ *                                at radial depth [RMIN, RMAX] mm
+ *
+ * cuts are compiled into named, typed Filter nodes placed before any Define,
+ * so rejected events skip the energy conversions. the names label the
+ * cut flow report of each cell.
+ */
+class Selection
+{
+public:
+  Selection() = default;
+  ~Selection() = default;
+
+  // returns false and logs the line on any error.
+  bool read(const std::string& path);
+  bool isEmpty() const;
+  ROOT::RDF::RNode apply(ROOT::RDF::RNode dataNode, bool isSensitive) const;
+
+private:
+  bool m_isSingleParticle = false;
+  size_t m_minRecHits = 0;
+  size_t m_maxRecHits = 0;
+  size_t m_minSimHits = 0;
+  double m_containmentRMin = 0.;
+  double m_containmentRMax = 0.;
+  double m_minContainment = 0.;
+};
+
+// events entering and passing one named cut of a cell.
+struct CutFlowRow
+{
+  std::string name;
+  unsigned long long nAll;
+  unsigned long long nPass;
+};
+
+#endif // SELECTION_HPP
@@ -0,0 +1,85 @@
+#ifndef SHAREDARRAY_HPP
+#define SHAREDARRAY_HPP
+
+// C++
+#include <memory>
+#include <new>
+#include <stdexcept>
+#include <type_traits>
+
+// POSIX
+#include <sys/mman.h>
+
+/*
+ * fixed size array in an anonymous shared mapping. processes forked after
+ * it is created read and write the same elements, so --processes workers
+ * store their results straight into the supervisor's memory. elements are
+ * value initialized and never destroyed, so they must not own memory;
+ * atomics work across processes when they are lock-free. copies share the
+ * elements.
+ */
+template<typename T>
+class SharedArray
+{
+  static_assert(
+    std::is_trivially_destructible<T>::value,
+    "SharedArray elements are never destroyed");
+
+public:
+  SharedArray() = default;
+  explicit SharedArray(size_t size)
+    : m_size(size)
+  {
+    if (size == 0) {
+      return;
+    }
+    size_t bytes = size * sizeof(T);
+    void* memory = mmap(
+      nullptr, bytes, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_ANONYMOUS, -1, 0);
+    if (memory == MAP_FAILED) {
+      throw std::runtime_error("failed to map shared memory.");
+    }
+    T* data = static_cast<T*>(memory);
+    for (size_t i = 0; i < size; ++i) {
+      new (data + i) T();
+    }
+    m_data = std::shared_ptr<T>(data, [bytes](T* p) { munmap(p, bytes); });
+  }
+
+  size_t size() const
+  {
+    return m_size;
+  }
+
+  T& operator[](size_t i)
+  {
+    return m_data.get()[i];
+  }
+  const T& operator[](size_t i) const
+  {
+    return m_data.get()[i];
+  }
+
+  T* begin()
+  {
+    return m_data.get();
+  }
+  T* end()
+  {
+    return m_data.get() + m_size;
+  }
+  const T* begin() const
+  {
+    return m_data.get();
+  }
+  const T* end() const
+  {
+    return m_data.get() + m_size;
+  }
+
+private:
+  std::shared_ptr<T> m_data;
+  size_t m_size = 0;
+};
+
+#endif // SHAREDARRAY_HPP
@@ -0,0 +1,125 @@
+#ifndef SHOWERPROFILE_HPP
+#define SHOWERPROFILE_HPP
+
+// C++
+#include <cmath>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+// ROOT
+#include "ROOT/RDataFrame.hxx"
+#include "TTreeReader.h"
+
+#include "RunOptions.hpp"
+
+// energy per layer and per radial bin summed over the events of a cell.
+struct ShowerProfile
+{
+  std::vector<double> layerSum;
+  std::vector<double> radialSum;
+  double nEvents = 0.;
+};
+
+/*
+ * RDataFrame action filling a ShowerProfile in the cell's event loop.
+ * every slot owns a flat, cache-line padded block of partial sums,
+ * so hits are added without locks or TH1 fills; blocks are merged once
+ * in Finalize(). with Sum = ExactSum the result does not depend on how
+ * events were spread over slots.
+ */
+template<typename Hit, typename Sum = double>
+class ShowerProfileHelper
+  : public ROOT::Detail::RDF::RActionImpl<ShowerProfileHelper<Hit, Sum>>
+{
+public:
+  using Result_t = ShowerProfile;
+
+  ShowerProfileHelper(
+    const ProfileBinning& binning,
+    double energyScale,
+    unsigned nSlots)
+    : m_binning(binning)
+    , m_energyScale(energyScale)
+    , m_nLayers(binning.nLayers())
+    , m_radialScale(binning.nRadialBins / (binning.radialMax - binning.radialMin))
+    , m_stride(
+        (binning.nLayers() + binning.nRadialBins + 1 + s_lineElements - 1)
+        / s_lineElements * s_lineElements)
+    , m_partials(nSlots * m_stride)
+    , m_result(std::make_shared<ShowerProfile>())
+  {
+  }
+  ShowerProfileHelper(ShowerProfileHelper&& helper) = default;
+  ShowerProfileHelper(const ShowerProfileHelper& helper) = delete;
+
+  std::shared_ptr<Result_t> GetResultPtr() const
+  {
+    return m_result;
+  }
+
+  void Initialize() {}
+  void InitTask(TTreeReader*, unsigned int) {}
+
+  void Exec(unsigned int slot, const std::vector<Hit>& hits)
+  {
+    Sum* layerSum = m_partials.data() + slot * m_stride;
+    Sum* radialSum = layerSum + m_nLayers;
+    const std::uint64_t layerMask = m_nLayers - 1;
+
+    for (const auto& hit : hits) {
+      double energy = hit.energy * m_energyScale;
+      size_t layer = (hit.cellID >> m_binning.layerOffset) & layerMask;
+      double r = std::hypot(hit.position.x, hit.position.y);
+      double radialBin = (r - m_binning.radialMin) * m_radialScale;
+
+      layerSum[layer] += energy;
+      if (radialBin >= 0. && radialBin < m_binning.nRadialBins) {
+        radialSum[static_cast<size_t>(radialBin)] += energy;
+      }
+    }
+    radialSum[m_binning.nRadialBins] += 1.;
+  }
+
+  void Finalize()
+  {
+    size_t nSlots = m_partials.size() / m_stride;
+    std::vector<Sum> total(m_stride);
+
+    for (size_t slot = 0; slot < nSlots; ++slot) {
+      const Sum* partial = m_partials.data() + slot * m_stride;
+      for (size_t i = 0; i < m_stride; ++i) {
+        total[i] += partial[i];
+      }
+    }
+    const Sum* radialSum = total.data() + m_nLayers;
+    m_result->layerSum.resize(m_nLayers);
+    m_result->radialSum.resize(m_binning.nRadialBins);
+    for (size_t i = 0; i < m_nLayers; ++i) {
+      m_result->layerSum[i] = double(total[i]);
+    }
+    for (size_t i = 0; i < m_binning.nRadialBins; ++i) {
+      m_result->radialSum[i] = double(radialSum[i]);
+    }
+    m_result->nEvents = double(radialSum[m_binning.nRadialBins]);
+  }
+
+  std::string GetActionName()
+  {
+    return "ShowerProfile";
+  }
+
+private:
+  const ProfileBinning m_binning;
+  const double m_energyScale;
+  const size_t m_nLayers;
+  const double m_radialScale;
+  const size_t m_stride;
+  std::vector<Sum> m_partials;
+  std::shared_ptr<ShowerProfile> m_result;
+
+  static constexpr size_t s_lineElements = 64 / sizeof(Sum);
+};
+
+#endif // SHOWERPROFILE_HPP
@@ -0,0 +1,51 @@
+#include "ThreadPool.hpp"
+
+ThreadPool::ThreadPool(size_t nWorkers)
+  : m_isStopped(false)
+{
+  if (nWorkers == 0) {
+    nWorkers = 1;
+  }
+  for (size_t i = 0; i < nWorkers; ++i) {
+    m_workers.emplace_back(&ThreadPool::work, this);
+  }
+}
+
+// remaining tasks are finished before the workers are joined.
+ThreadPool::~ThreadPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_isStopped = true;
+  }
+  m_cv.notify_all();
+  for (auto& worker : m_workers) {
+    worker.join();
+  }
+}
+
+size_t
+ThreadPool::defaultSize()
+{
+  size_t nCores = std::thread::hardware_concurrency();
+
+  return nCores == 0 ? 1 : nCores;
+}
+
+void
+ThreadPool::work()
+{
+  while (true) {
+    std::function<void()> task;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_cv.wait(lock, [this]() { return m_isStopped || !m_tasks.empty(); });
+      if (m_tasks.empty()) {
+        return;
+      }
+      task = std::move(m_tasks.front());
+      m_tasks.pop();
+    }
+    task();
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+// C++
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <memory>
+#include <mutex>
+#include <queue>
+#include <thread>
+#include <vector>
+
+/*
+ * fixed-size worker pool.
+ * tasks are executed in submission order by whichever worker is idle.
+ * waiting on a future from inside a task of the same pool can deadlock,
+ * so nested work should go to another pool or run inline.
+ */
+class ThreadPool
+{
+public:
+  explicit ThreadPool(size_t nWorkers);
+  ~ThreadPool();
+
+  ThreadPool(const ThreadPool& pool) = delete;
+  ThreadPool& operator=(const ThreadPool& pool) = delete;
+
+  template<typename Func>
+  auto submit(Func&& func) -> std::future<decltype(func())>
+  {
+    using Result = decltype(func());
+    auto task =
+      std::make_shared<std::packaged_task<Result()>>(std::forward<Func>(func));
+    std::future<Result> future = task->get_future();
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_tasks.emplace([task]() { (*task)(); });
+    }
+    m_cv.notify_one();
+    return future;
+  }
+
+  size_t size() const
+  {
+    return m_workers.size();
+  };
+
+  static size_t defaultSize();
+
+private:
+  void work();
+
+private:
+  std::vector<std::thread> m_workers;
+  std::queue<std::function<void()>> m_tasks;
+  std::mutex m_mutex;
+  std::condition_variable m_cv;
+  bool m_isStopped;
+};
+
+#endif // THREADPOOL_HPP
@@ -1,4 +1,6 @@
+#include <cstdint>
 #include <iostream>
+#include <string>
 #include <vector>
 
 #include "TFile.h"
@@ -10,23 +12,47 @@
 #include "fmt/core.h"
 #include "Energy.hpp"
 #include "Eta.hpp"
+#include "ExportTable.hpp"
+#include "Logger.hpp"
 
 void
-edepRatio(std::string edepPath);
+edepRatio(std::string edepPath, ExportTable::Format exportFormat);
 
+// [--export arrow|parquet] PATH, run by the ratio binary or by the fsam
+// daemon. messages about the command line itself go to err.
 int
-main(int argc, char** argv)
+runEdepRatio(const std::vector<std::string>& words, std::ostream& err)
 {
-  if (argc != 2) {
-    std::cerr << "invalid arguments\n";
+  ExportTable::Format exportFormat = ExportTable::kNone;
+
+  if (words.size() == 3 && words[0] == "--export") {
+    if (ExportTable::parseFormat(words[1], exportFormat) == false) {
+      err << "invalid export format " << words[1] << "\n";
+      return 1;
+    }
+    if (ExportTable::isAvailable() == false) {
+      err << "--export: built without Arrow, rebuild with make ARROW=1\n";
+      return 1;
+    }
+  } else if (words.size() != 1) {
+    err << "invalid arguments\n";
     return 1;
   }
-  edepRatio(argv[1]);
+  edepRatio(words.back(), exportFormat);
   return 0;
 }
 
+// the fsam binary links this file for its daemon and has its own main.
+#ifdef EDEPRATIO_MAIN
+int
+main(int argc, char** argv)
+{
+  return runEdepRatio(std::vector<std::string>(argv + 1, argv + argc), std::cerr);
+}
+#endif
+
 void
-edepRatio(std::string edepPath)
+edepRatio(std::string edepPath, ExportTable::Format exportFormat)
 {
   if (edepPath.back() != '/') {
     edepPath.push_back('/');
@@ -43,28 +69,36 @@ edepRatio(std::string edepPath)
   TFile* edepFile = TFile::Open(edepPath.c_str(), "READ");
   TFile* ratioFile = TFile::Open(ratioPath.c_str(), "CREATE");
   TGraph2DErrors* graph = new TGraph2DErrors();
+  // columns of the --export table, one row per cell in grid order.
+  const size_t nCells = energyBins.size() * etaBins.size();
+  std::vector<std::int64_t> exportEnergyBins(nCells);
+  std::vector<std::int64_t> exportEtaBins(nCells);
+  std::vector<double> exportEnergies(nCells);
+  std::vector<double> exportEtas(nCells);
+  std::vector<double> exportEdeps(nCells);
+  std::vector<double> exportEdepErrors(nCells);
+  std::vector<double> exportRatios(nCells);
+  std::vector<double> exportRatioErrors(nCells);
 
-  std::cout << "energy bins\n";
   for (size_t i = 0; i < energyBins.size(); ++i) {
-    std::cout << energyBins[i] << '\n';
+    Logger::debug("energy bin {}", energyBins[i]);
   }
-  std::cout << "eta bins\n";
   for (size_t i = 0; i < etaBins.size(); ++i) {
-    std::cout << etaBins.getMiddleValue(i) << '\n';
+    Logger::debug("eta bin {}", etaBins.getMiddleValue(i));
   }
 
   if (edepFile == nullptr || edepFile->IsOpen() == kFALSE) {
-    std::cerr << fmt::format("cannot open file {}\n", edepPath);
+    Logger::error("cannot open file {}", edepPath);
     return;
   }
   if (ratioFile == nullptr || ratioFile->IsOpen() == kFALSE) {
-    std::cerr << fmt::format("cannot open file {}\n", ratioPath);
+    Logger::error("cannot open file {}", ratioPath);
     return;
   }
 
   for (size_t i = 0; i < energyBins.size(); ++i) {
     std::string histName{fmt::format("E{}", energyBins[i])};
-    std::cout << "reading " << histName << '\n';
+    Logger::debug("reading {}", histName);
 
     TH1D* edepHist = edepFile->Get<TH1D>(histName.c_str());
     TH1D* ratioHist = new TH1D(
@@ -74,7 +108,7 @@ edepRatio(std::string edepPath)
       etaBins.getBinEdges());
     ratioEHists.push_back(ratioHist);
     if (ratioHist == nullptr) {
-      std::cerr << "failed to allocate TH1D\n";
+      Logger::error("failed to allocate TH1D");
       return;
     }
     for (size_t j = 0; j < etaBins.size(); ++j) {
@@ -92,6 +126,15 @@ edepRatio(std::string edepPath)
       }
       ratioHist->SetBinContent(j + 1, ratio);
       ratioHist->SetBinError(j + 1, ratioError);
+      size_t cell = i * etaBins.size() + j;
+      exportEnergyBins[cell] = i;
+      exportEtaBins[cell] = j;
+      exportEnergies[cell] = energyBins[i];
+      exportEtas[cell] = etaBins.getMiddleValue(j);
+      exportEdeps[cell] = edep;
+      exportEdepErrors[cell] = edepError;
+      exportRatios[cell] = ratio;
+      exportRatioErrors[cell] = ratioError;
       graph->SetPoint(
         i * etaBins.size() + j,
         etaBins.getMiddleValue(j),
@@ -106,7 +149,7 @@ edepRatio(std::string edepPath)
 
   for (size_t i = 0; i < etaBins.size(); ++i) {
     std::string histName{fmt::format("eta{}", etaBins.getMiddleValue(i))};
-    std::cout << "reading " << histName << '\n';
+    Logger::debug("reading {}", histName);
 
     TH1D* edepHist = edepFile->Get<TH1D>(histName.c_str());
     TH1D* ratioHist = new TH1D(
@@ -116,10 +159,9 @@ edepRatio(std::string edepPath)
       energyBins.getBinEdges());
     ratioEtaHists.push_back(ratioHist);
     if (ratioHist == nullptr) {
-      std::cerr << "failed to allocate TH1D\n";
+      Logger::error("failed to allocate TH1D");
       return;
     }
-    std::cout << "\neta=" << etaBins.getMiddleValue(i) << '\n';
     for (size_t j = 0; j < energyBins.size(); ++j) {
       double edep = edepHist->GetBinContent(j + 1);
       double edepError = edepHist->GetBinError(j + 1);
@@ -132,7 +174,12 @@ edepRatio(std::string edepPath)
       } else {
         ratio = edep / energyBins[j];
         ratioError = edepError / energyBins[j];
-        std::cout << fmt::format("edep={:.4}\tebin={:5}\tratio={}\n", edep, energyBins[j], ratio);
+        Logger::debug(
+          "eta={} edep={:.4} ebin={:5} ratio={}",
+          etaBins.getMiddleValue(i),
+          edep,
+          energyBins[j],
+          ratio);
       }
       ratioHist->SetBinContent(j + 1, ratio);
       ratioHist->SetBinError(j + 1, ratioError);
@@ -141,6 +188,18 @@ edepRatio(std::string edepPath)
   }
   graph->SetTitle("Deposit Energy to True Energy Ratio; Eta; Energy; Ratio");
   graph->SaveAs(fmt::format("{}edepRatio2Dgraph.root", resultPath).c_str());
+  if (exportFormat != ExportTable::kNone) {
+    ExportTable table("fsam.edepRatio", 1);
+    table.addColumn("energyBin", std::move(exportEnergyBins));
+    table.addColumn("etaBin", std::move(exportEtaBins));
+    table.addColumn("energy", std::move(exportEnergies));
+    table.addColumn("eta", std::move(exportEtas));
+    table.addColumn("edep", std::move(exportEdeps));
+    table.addColumn("edepError", std::move(exportEdepErrors));
+    table.addColumn("ratio", std::move(exportRatios));
+    table.addColumn("ratioError", std::move(exportRatioErrors));
+    table.write(resultPath + "edepRatio", exportFormat);
+  }
   ratioFile->cd();
   for (TH1D* hist : ratioEHists) {
     hist->Write();
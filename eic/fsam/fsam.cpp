@@ -1,59 +1,367 @@
+#include <algorithm>
 #include <iostream>
+#include <sstream>
 #include <string>
+#include <vector>
 
 #include <fmt/core.h>
 
+#include "Daemon.hpp"
 #include "HistManager.hpp"
+#include "Logger.hpp"
+#include "RunOptions.hpp"
 
 void
-getFsam(std::string recPath, std::string edepPath);
+getFsam(std::string recPath, std::string edepPath, const RunOptions& options);
+bool
+getFsamBatch(const std::string& manifestPath, const RunOptions& options);
 
 int
-fsam(std::string pathPrefix)
+fsam(std::string pathPrefix, const RunOptions& options)
 {
   bool isSensitive = false;
 
   if (pathPrefix.back() != '/') {
     pathPrefix.push_back('/');
   }
-  std::cout << pathPrefix << '\n';
+  Logger::info("{}", pathPrefix);
   if (pathPrefix.find("sensitive") == std::string::npos) {
-    std::cout << "reconstructed hits will be computed\n";
+    Logger::info("reconstructed hits will be computed");
   } else {
-    std::cout << "energy deposit will be computed\n";
+    Logger::info("energy deposit will be computed");
     isSensitive = true;
   }
 
-  HistManager histManager{ pathPrefix, isSensitive };
+  HistManager histManager{ pathPrefix, isSensitive, options };
 
   histManager.process();
   histManager.storeHists();
   return 0;
 }
 
+// options come before the paths. returns false on unknown or incomplete option.
+static bool
+parseOptions(
+  const std::vector<std::string>& words,
+  RunOptions& options,
+  std::vector<std::string>& args,
+  std::ostream& err)
+{
+  for (size_t i = 0; i < words.size(); ++i) {
+    const std::string& arg = words[i];
+
+    if (arg.rfind("--", 0) != 0) {
+      args.push_back(arg);
+      continue;
+    }
+    if (arg == "--profiles") {
+      options.isProfiling = true;
+      continue;
+    }
+    if (arg == "--reproducible") {
+      options.isReproducible = true;
+      continue;
+    }
+    if (arg == "--imaging") {
+      options.isImaging = true;
+      continue;
+    }
+    if (arg == "--export-events") {
+      options.isExportingEvents = true;
+      continue;
+    }
+    if (arg == "--startup-report") {
+      options.isStartupReport = true;
+      continue;
+    }
+    if (arg == "--preview") {
+      options.isPreview = true;
+      continue;
+    }
+    if (arg == "--perf-counters") {
+      options.isPerfCounters = true;
+      continue;
+    }
+    if (arg == "--fit-ladder") {
+      options.isFitLadder = true;
+      continue;
+    }
+    if (i + 1 >= words.size()) {
+      err << fmt::format("{}: missing value\n", arg);
+      return false;
+    }
+    const std::string& value = words[++i];
+    try {
+      if (arg == "--batch") {
+        options.batchManifest = value;
+      } else if (arg == "--jobs") {
+        options.nJobs = std::stoul(value);
+      } else if (arg == "--threads") {
+        options.nThreads = std::stoul(value);
+        if (options.nThreads == 0) {
+          throw std::invalid_argument(value);
+        }
+      } else if (arg == "--processes") {
+        options.nProcesses = std::stoul(value);
+        if (options.nProcesses == 0) {
+          throw std::invalid_argument(value);
+        }
+      } else if (arg == "--memory-budget") {
+        options.memoryBudgetMB = std::stoul(value);
+      } else if (arg == "--target-precision") {
+        options.targetPrecision = std::stod(value);
+        if (!(options.targetPrecision > 0.)) {
+          throw std::invalid_argument(value);
+        }
+      } else if (arg == "--bootstrap") {
+        options.nBootstrap = std::stoul(value);
+      } else if (arg == "--layer-field") {
+        ProfileBinning& binning = options.profileBinning;
+        std::stringstream ss(value);
+        char colon = 0;
+        ss >> binning.layerOffset >> colon >> binning.layerWidth;
+        if (ss.fail() || colon != ':' || binning.layerWidth == 0
+            || binning.layerWidth > 16 || binning.layerOffset > 63) {
+          throw std::invalid_argument(value);
+        }
+      } else if (arg == "--radial-bins") {
+        ProfileBinning& binning = options.profileBinning;
+        std::stringstream ss(value);
+        char colon1 = 0;
+        char colon2 = 0;
+        ss >> binning.nRadialBins >> colon1 >> binning.radialMin >> colon2
+          >> binning.radialMax;
+        if (ss.fail() || colon1 != ':' || colon2 != ':'
+            || binning.nRadialBins == 0
+            || binning.radialMax <= binning.radialMin) {
+          throw std::invalid_argument(value);
+        }
+      } else if (arg == "--lut-interp") {
+        if (value != "bilinear" && value != "bicubic") {
+          throw std::invalid_argument(value);
+        }
+        options.lutInterpolation =
+          value == "bicubic" ? FsamTable::kBicubic : FsamTable::kBilinear;
+      } else if (arg == "--lut-extrap") {
+        if (value != "clamp" && value != "linear") {
+          throw std::invalid_argument(value);
+        }
+        options.lutExtrapolation =
+          value == "linear" ? FsamTable::kLinear : FsamTable::kClamp;
+      } else if (arg == "--lut-smooth") {
+        options.lutSmooth = std::stoul(value);
+      } else if (arg == "--fsam-table") {
+        options.fsamTablePath = value;
+      } else if (arg == "--progress-file") {
+        options.progressPath = value;
+      } else if (arg == "--selection") {
+        options.selectionPath = value;
+      } else if (arg == "--export") {
+        if (ExportTable::parseFormat(value, options.exportFormat) == false) {
+          throw std::invalid_argument(value);
+        }
+        if (ExportTable::isAvailable() == false) {
+          err << "--export: built without Arrow, rebuild with make ARROW=1\n";
+          return false;
+        }
+      } else if (arg == "--thresholds") {
+        std::stringstream ss(value);
+        std::string item;
+        options.hitThresholds.clear();
+        while (std::getline(ss, item, ',')) {
+          size_t end = 0;
+          double threshold = std::stod(item, &end);
+          if (end != item.size() || !(threshold >= 0.)) {
+            throw std::invalid_argument(value);
+          }
+          options.hitThresholds.push_back(threshold);
+        }
+        if (options.hitThresholds.empty()) {
+          throw std::invalid_argument(value);
+        }
+        std::sort(options.hitThresholds.begin(), options.hitThresholds.end());
+        options.hitThresholds.erase(
+          std::unique(options.hitThresholds.begin(), options.hitThresholds.end()),
+          options.hitThresholds.end());
+      } else if (arg == "--log-level") {
+        Logger::Level level;
+        if (Logger::parseLevel(value, level) == false) {
+          throw std::invalid_argument(value);
+        }
+        Logger::setLevel(level);
+      } else {
+        err << fmt::format("{}: unknown option\n", arg);
+        return false;
+      }
+    } catch (const std::exception&) {
+      err << fmt::format("{}: invalid value '{}'\n", arg, value);
+      return false;
+    }
+  }
+  return true;
+}
+
+// one fsam command line without the program name, run directly by main or
+// by the daemon. messages about the command line itself go to err.
 int
-main(int argc, char** argv)
+runFsam(const std::vector<std::string>& words, std::ostream& err)
 {
-  if (argc == 2) {
-    std::cout << "Generating ROOT\n";
-    fsam(argv[1]);
-  } else if (argc == 3) {
-    std::cout << "Computing samping fraction\n";
-    getFsam(argv[1], argv[2]);
+  RunOptions options;
+  std::vector<std::string> args;
+  bool isValid = parseOptions(words, options, args, err);
+
+  if (isValid && options.isExportingEvents
+      && options.exportFormat == ExportTable::kNone) {
+    err << "--export-events needs --export\n";
+    isValid = false;
+  }
+  if (isValid && options.targetPrecision > 0. && options.isReproducible
+      && options.nThreads > 0) {
+    err << "--target-precision with --threads depends on scheduling and "
+           "cannot be --reproducible\n";
+    isValid = false;
+  }
+  // a preview has no histograms to fit, refit or store.
+  if (isValid && options.isPreview
+      && (options.nBootstrap > 0 || options.isFitLadder || options.isProfiling
+          || options.isExportingEvents || options.targetPrecision > 0.)) {
+    err << "--preview cannot be combined with --bootstrap, --fit-ladder, "
+           "--profiles, --export-events or --target-precision\n";
+    isValid = false;
+  }
+  // worker processes return only what fits the shared results matrix.
+  if (isValid && options.nProcesses > 0
+      && (options.nBootstrap > 0 || options.isProfiling
+          || options.isExportingEvents || options.isStartupReport
+          || options.isPerfCounters
+          || options.targetPrecision > 0.
+          || options.selectionPath.empty() == false
+          || options.memoryBudgetMB > 0 || options.nJobs > 0)) {
+    err << "--processes cannot be combined with --bootstrap, --profiles, "
+           "--export-events, --startup-report, --perf-counters, "
+           "--target-precision, --selection, --memory-budget or --jobs\n";
+    isValid = false;
+  }
+  if (isValid && options.batchManifest.empty() == false && args.empty()) {
+    Logger::info("Computing samping fraction in batch");
+    if (getFsamBatch(options.batchManifest, options) == false) {
+      return 1;
+    }
+  } else if (isValid && args.size() == 1) {
+    Logger::info("Generating ROOT");
+    fsam(args[0], options);
+  } else if (isValid && args.size() == 2) {
+    Logger::info("Computing samping fraction");
+    getFsam(args[0], args[1], options);
   } else {
-    std::cerr << fmt::format("usage: {} PATH1 [PATH2]\n", argv[0]);
-    std::cerr << fmt::format(
+    err << "usage: fsam [OPTIONS] PATH1 [PATH2]\n";
+    err << "       fsam --serve SOCKET\n";
+    err << fmt::format(
 "\n\
 1) if PATH2 is not given, it will generate ROOT and pdf files using data in the PATH1.\n\
    if PATH1 contains \"sensitive\" keyword, it will compute deposit energy.\n\
 ");
-    std::cerr << fmt::format(
+    err << fmt::format(
 "\n\
 2) if PATH1 and PATH2 are given, it will generate sampling fraction ROOT file\n\
    using PATH1 as reconstructed energy sum and PATH2 as deposit energy sum\n\
+");
+    err << fmt::format(
+"\n\
+3) with --serve, stay resident and run the command lines sent by fsamc over\n\
+   the Unix socket SOCKET, see Daemon.hpp\n\
+");
+    err << fmt::format(
+"\n\
+OPTIONS:\n\
+  --batch MANIFEST  run getFsam for every 'REC EDEP [OUTPUT]' line of MANIFEST\n\
+                    concurrently and write MANIFEST.summary\n\
+  --jobs N          number of worker threads (default: number of cores,\n\
+                    number of energy bins for PATH1 only)\n\
+  --threads N       PATH1 only: N threads shared by the cells running at\n\
+                    once, the implicit MT event loops inside them and the\n\
+                    bootstrap, ladder and resolution fits; at most N cells\n\
+                    run concurrently\n\
+  --processes N     PATH1 only: run the cells in N forked worker processes\n\
+                    instead of threads; a cell whose worker crashes is\n\
+                    retried by a new worker. --threads is then per worker\n\
+  --memory-budget MB\n\
+                    admit cells only while their estimated memory fits in MB\n\
+  --target-precision REL\n\
+                    PATH1 only: stop reading a cell once the relative\n\
+                    error on the mean of fsam (simEnergy for sensitive\n\
+                    runs) is below REL and write the events used per cell\n\
+                    to earlyStop.tsv\n\
+  --preview         PATH1 only: no histograms, fits or PDFs; one pass per\n\
+                    cell computes mean, median (quantile sketch), 10%\n\
+                    truncated mean, std dev and event count of every\n\
+                    column. the truncated mean stands in for the fitted\n\
+                    mean in the usual outputs, written to PATH1/preview/\n\
+                    with all estimators in preview.tsv\n\
+  --bootstrap N     refit N Poisson-weighted replicas of every cell on all\n\
+                    cores and store them as 'bootstrap_*' trees\n\
+  --imaging         also fit recEnergy, fsam and simEnergy of the Imaging\n\
+                    layers and of ScFi + Imaging in the same event loop and\n\
+                    write their <column>2Dgraph.root\n\
+  --fit-ladder      fit every cell with several windows, a chi2 fit and a\n\
+                    Crystal Ball at once and keep the converged fit with\n\
+                    the smallest chi2/ndf, recovering failed cells\n\
+  --profiles        accumulate energy per layer and radial depth of every\n\
+                    cell in the same event loop and write profiles.root\n\
+  --startup-report  PATH1 only: count RDataFrame JIT compilations and write\n\
+                    the time from the start of every cell to its first\n\
+                    event to startup.tsv\n\
+  --perf-counters   PATH1 only: count cycles, instructions, cache misses\n\
+                    and branch misses of file opening, event loop, hit\n\
+                    conversions, fits and rendering per thread with\n\
+                    perf_event_open and write perfCounters.tsv; ignored\n\
+                    with a warning where counters are unavailable\n\
+  --reproducible    exact sums and statistics recomputed from bin contents,\n\
+                    so outputs are bit identical for any thread count\n\
+  --layer-field OFFSET:WIDTH\n\
+                    cellID bits of the layer (default: 14:6)\n\
+  --radial-bins N:MIN:MAX\n\
+                    radial depth binning in mm (default: 40:750:1250)\n\
+  --lut-interp bilinear|bicubic\n\
+  --lut-extrap clamp|linear\n\
+  --lut-smooth N    policy of the exported fsamTable.bin (default: bilinear,\n\
+                    clamp, no smoothing); empty cells are always filled\n\
+                    from their neighbours\n\
+  --fsam-table FILE correct the visible energy of every event with\n\
+                    fsam(E, eta) of FILE and write the closure to\n\
+                    closure2Dgraph.root\n\
+  --progress-file FILE\n\
+                    rewrite FILE every 5 s with cell counts, events per\n\
+                    second and remaining time in Prometheus text format\n\
+  --selection FILE  apply the cuts of FILE before histogramming and write\n\
+                    the cut flow of every cell to cutflow.tsv\n\
+  --thresholds T1,T2,...\n\
+                    also fit recEnergy and fsam with hits below each\n\
+                    threshold in GeV removed, all from the same event loop,\n\
+                    and write thresholdScan.root; T<i> is the i-th\n\
+                    threshold in increasing order\n\
+  --export arrow|parquet\n\
+                    also write the per cell results as cells.arrow or\n\
+                    cells.parquet (fsam.arrow/.parquet for PATH1 PATH2);\n\
+                    needs a build with make ARROW=1\n\
+  --export-events   PATH1 only: with --export, also write genEnergy and the\n\
+                    fitted columns of every event to events.arrow/.parquet\n\
+  --log-level LEVEL debug, info, warning or error (default: info)\n\
 ");
     return 1;
-    std::cerr << "invalid arguments\n";
+    err << "invalid arguments\n";
   }
   return 0;
 }
+
+int
+main(int argc, char** argv)
+{
+  std::vector<std::string> words(argv + 1, argv + argc);
+
+  if (words.size() == 2 && words[0] == "--serve") {
+    Daemon daemon{ words[1] };
+    return daemon.run();
+  }
+  return runFsam(words, std::cerr);
+}
@@ -0,0 +1,103 @@
+// C++
+#include <cerrno>
+#include <climits>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+
+// POSIX
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <unistd.h>
+
+/*
+ * fsamc: thin client of fsam --serve. links neither ROOT nor fmt, so it
+ * starts in milliseconds. sends one command line to the daemon, prints
+ * the streamed log and exits with the status of the job.
+ *
+ *   fsamc SOCKET fsam [OPTIONS] PATH1 [PATH2]
+ *   fsamc SOCKET ratio [--export FORMAT] PATH
+ *   fsamc SOCKET stop
+ *
+ * relative paths are resolved in the working directory of the client.
+ * must match Daemon::s_protocol.
+ */
+static const char* const protocol = "fsam-daemon 1";
+
+int
+main(int argc, char** argv)
+{
+  if (argc < 3) {
+    std::cerr << "usage: fsamc SOCKET fsam|ratio|stop [ARGS...]\n";
+    return 2;
+  }
+
+  char workingDirectory[PATH_MAX];
+  if (getcwd(workingDirectory, sizeof(workingDirectory)) == nullptr) {
+    std::cerr << "getcwd: " << std::strerror(errno) << "\n";
+    return 2;
+  }
+  std::string request = std::string(protocol) + "\n" + workingDirectory + "\n";
+  for (int i = 2; i < argc; ++i) {
+    if (argv[i][0] == '\0' || std::strchr(argv[i], '\n') != nullptr) {
+      std::cerr << "empty arguments and newlines cannot be sent\n";
+      return 2;
+    }
+    request += std::string(argv[i]) + "\n";
+  }
+  request += "\n";
+
+  sockaddr_un address{};
+  if (std::strlen(argv[1]) >= sizeof(address.sun_path)) {
+    std::cerr << "socket path too long: " << argv[1] << "\n";
+    return 2;
+  }
+  address.sun_family = AF_UNIX;
+  std::strcpy(address.sun_path, argv[1]);
+  int fd = socket(AF_UNIX, SOCK_STREAM, 0);
+  if (fd < 0
+      || connect(fd, reinterpret_cast<sockaddr*>(&address), sizeof(address))
+           != 0) {
+    std::cerr << "cannot connect to " << argv[1] << ": " << std::strerror(errno)
+              << "\n";
+    return 2;
+  }
+  for (size_t sent = 0; sent < request.size();) {
+    ssize_t n = send(fd, request.data() + sent, request.size() - sent, 0);
+    if (n <= 0) {
+      std::cerr << "send: " << std::strerror(errno) << "\n";
+      return 2;
+    }
+    sent += n;
+  }
+
+  // the connection ends after the exit line; without one the daemon died.
+  std::string buffer;
+  char chunk[4096];
+  ssize_t n;
+  while ((n = recv(fd, chunk, sizeof(chunk), 0)) > 0) {
+    buffer.append(chunk, n);
+    size_t end;
+    while ((end = buffer.find('\n')) != std::string::npos) {
+      std::string line = buffer.substr(0, end);
+      buffer.erase(0, end + 1);
+      if (line.rfind("out ", 0) == 0) {
+        std::cout << line.substr(4) << std::endl;
+      } else if (line.rfind("err ", 0) == 0) {
+        std::cerr << line.substr(4) << "\n";
+      } else if (line.rfind("queued ", 0) == 0) {
+        if (line != "queued 0") {
+          std::cerr << "waiting for " << line.substr(7) << " jobs\n";
+        }
+      } else if (line.rfind("exit ", 0) == 0) {
+        close(fd);
+        return std::atoi(line.c_str() + 5);
+      }
+    }
+  }
+  close(fd);
+  std::cerr << "connection to the daemon lost\n";
+  return 2;
+}
@@ -0,0 +1,92 @@
+#include <chrono>
+#include <cmath>
+#include <cstdint>
+#include <iostream>
+#include <vector>
+
+#include <fmt/core.h>
+
+#include "FsamTable.hpp"
+
+/*
+ * micro-benchmark of FsamTable::lookup().
+ * usage: bench [TABLE]
+ * without TABLE a synthetic table on the simulation grid is written to
+ * /tmp and used, so the numbers do not depend on a finished campaign.
+ */
+static std::string
+writeSyntheticTable(FsamTable::Interpolation interpolation)
+{
+  std::vector<double> energy{ 0.10, 0.15, 0.20, 0.25, 0.30, 0.35, 0.40,
+                              0.45, 0.50, 0.75, 1.00, 1.50, 2.00, 2.50,
+                              3.00, 4.00, 5.00, 6.00, 7.00, 8.00, 9.00,
+                              10.0, 11.0, 12.0, 13.5, 15.0, 16.5, 18.0 };
+  std::vector<double> eta{ -1.65, -1.55, -1.25, -0.75, -0.25,
+                           0.25,  0.75,  1.1,   1.25 };
+  std::vector<double> values;
+  std::vector<char> valid;
+
+  for (double e : energy) {
+    for (double h : eta) {
+      values.push_back(0.1 - 0.002 * std::log(e) + 0.001 * h * h);
+      valid.push_back(1);
+    }
+  }
+  std::string path = fmt::format("/tmp/fsamTableBench_{}.bin", int(interpolation));
+  FsamTable::write(
+    path, energy, eta, values, valid, interpolation, FsamTable::kClamp, 0);
+  return path;
+}
+
+static void
+bench(const FsamTable& table, const char* name)
+{
+  const size_t nQueries = 1 << 12;
+  const size_t nRepeats = 2000;
+  std::vector<double> energy(nQueries);
+  std::vector<double> eta(nQueries);
+  std::uint64_t state = 12345;
+
+  // queries are precomputed so the loop measures only lookup().
+  for (size_t i = 0; i < nQueries; ++i) {
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    energy[i] = 0.1 + 18. * ((state >> 11) * 0x1.0p-53);
+    state = state * 6364136223846793005ULL + 1442695040888963407ULL;
+    eta[i] = -1.7 + 3. * ((state >> 11) * 0x1.0p-53);
+  }
+
+  double sum = 0.;
+  auto begin = std::chrono::steady_clock::now();
+  for (size_t r = 0; r < nRepeats; ++r) {
+    for (size_t i = 0; i < nQueries; ++i) {
+      sum += table.lookup(energy[i], eta[i]);
+    }
+  }
+  auto end = std::chrono::steady_clock::now();
+  double ns = std::chrono::duration<double, std::nano>(end - begin).count();
+  std::cout << fmt::format(
+    "{:<9} {:6.1f} ns/lookup (checksum {:.6f})\n",
+    name,
+    ns / (nQueries * nRepeats),
+    sum / (nQueries * nRepeats));
+}
+
+int
+main(int argc, char** argv)
+{
+  FsamTable table;
+
+  if (argc == 2) {
+    if (table.read(argv[1]) == false) {
+      std::cerr << fmt::format("cannot read table {}\n", argv[1]);
+      return 1;
+    }
+    bench(table, argv[1]);
+    return 0;
+  }
+  table.read(writeSyntheticTable(FsamTable::kBilinear));
+  bench(table, "bilinear");
+  table.read(writeSyntheticTable(FsamTable::kBicubic));
+  bench(table, "bicubic");
+  return 0;
+}
@@ -1,78 +1,203 @@
-#include <iostream>
+#include <algorithm>
+#include <atomic>
+#include <fstream>
+#include <map>
+#include <mutex>
+#include <sstream>
 #include <vector>
 
 #include "TFile.h"
 #include "TH1.h"
 #include "TH1D.h"
 #include "TGraph2DErrors.h"
+#include "TTree.h"
+#include "TTreeReader.h"
+#include "TTreeReaderValue.h"
 #include "ROOT/RDataFrame.hxx"
 
 #include "fmt/core.h"
+#include "Bootstrap.hpp"
 #include "Energy.hpp"
 #include "Eta.hpp"
+#include "ExportTable.hpp"
+#include "FsamTable.hpp"
+#include "Logger.hpp"
+#include "RunOptions.hpp"
+#include "ThreadPool.hpp"
 
-void
-getFsam(std::string recPath, std::string edepPath)
+// cell values of a 1DHists.root file indexed by energyBin * etaSize + etaBin.
+// 'E' and 'eta' histograms of HistManager hold the same cell values,
+// so the 'E' histograms are enough to rebuild both.
+// replicas are empty unless HistManager ran with --bootstrap.
+struct CellTable
+{
+  std::vector<double> value;
+  std::vector<double> error;
+  std::vector<std::vector<double>> replicas;
+  bool isValid = false;
+};
+
+// one line of the summary written by getFsamBatch.
+struct FsamSummary
+{
+  size_t nCells = 0;
+  size_t nFilled = 0;
+  double mean = 0.;
+  double min = 0.;
+  double max = 0.;
+  bool isValid = false;
+};
+
+static void
+readBootstrapTree(
+  TFile* file,
+  const std::string& columnName,
+  const Eta& etaBins,
+  CellTable& table)
 {
-  if (recPath.back() != '/') {
-    recPath.push_back('/');
+  TTree* tree = file->Get<TTree>(fmt::format("bootstrap_{}", columnName).c_str());
+
+  if (tree == nullptr) {
+    return;
   }
-  if (edepPath.back() != '/') {
-    edepPath.push_back('/');
+  TTreeReader reader(tree);
+  TTreeReaderValue<int> energyBin(reader, "energyBin");
+  TTreeReaderValue<int> etaBin(reader, "etaBin");
+  TTreeReaderValue<std::vector<double>> replicas(reader, "replicas");
+
+  table.replicas.assign(table.value.size(), {});
+  while (reader.Next()) {
+    size_t cell = *energyBin * etaBins.size() + *etaBin;
+    if (cell < table.replicas.size()) {
+      table.replicas[cell] = *replicas;
+    }
   }
+  Logger::info("bootstrap replicas of {} are read", columnName);
+}
 
-  Eta etaBins{recPath + "ETA_range"};
-  Energy energyBins{recPath + "E_range"};
+static CellTable
+readCellTable(
+  const std::string& path,
+  const std::string& columnName,
+  const Energy& energyBins,
+  const Eta& etaBins)
+{
+  CellTable table;
+  TFile* file = TFile::Open(path.c_str(), "READ");
+
+  if (file == nullptr || file->IsOpen() == kFALSE) {
+    Logger::error("cannot open file {}", path);
+    delete file;
+    return table;
+  }
+  table.value.assign(energyBins.size() * etaBins.size(), 0.);
+  table.error.assign(energyBins.size() * etaBins.size(), 0.);
+  for (size_t i = 0; i < energyBins.size(); ++i) {
+    std::string histName{fmt::format("E{}", energyBins[i])};
+    Logger::debug("reading {} from {}", histName, path);
 
-  std::string resultPath = edepPath;
+    TH1D* hist = file->Get<TH1D>(histName.c_str());
+    if (hist == nullptr) {
+      Logger::error("failed to read histogram {}", histName);
+      file->Close();
+      delete file;
+      return table;
+    }
+    for (size_t j = 0; j < etaBins.size(); ++j) {
+      table.value[i * etaBins.size() + j] = hist->GetBinContent(j + 1);
+      table.error[i * etaBins.size() + j] = hist->GetBinError(j + 1);
+    }
+    delete hist;
+  }
+  readBootstrapTree(file, columnName, etaBins, table);
+  file->Close();
+  delete file;
+  table.isValid = true;
+  return table;
+}
+
+static FsamSummary
+writeFsam(
+  const CellTable& recTable,
+  const CellTable& edepTable,
+  const Energy& energyBins,
+  const Eta& etaBins,
+  const std::string& resultPath,
+  const RunOptions& options)
+{
+  FsamSummary summary;
+  std::vector<double> tableValues(energyBins.size() * etaBins.size(), 0.);
+  std::vector<char> tableValid(tableValues.size(), 0);
   std::string fsamPath = resultPath + "fsam1DHists.root";
-  recPath += "1DHists.root";
-  edepPath += "1DHists.root";
   std::vector<TH1D*> fsamEHists;
   std::vector<TH1D*> fsamEtaHists;
-  TFile* recFile = TFile::Open(recPath.c_str(), "READ");
-  TFile* edepFile = TFile::Open(edepPath.c_str(), "READ");
   TFile* fsamFile = TFile::Open(fsamPath.c_str(), "CREATE");
-  TGraph2DErrors* graph = new TGraph2DErrors();
+  bool hasBootstrap =
+    recTable.replicas.empty() == false && edepTable.replicas.empty() == false;
+  // columns of the --export table, one row per cell in grid order.
+  const size_t nCells = tableValues.size();
+  std::vector<std::int64_t> exportEnergyBins(nCells);
+  std::vector<std::int64_t> exportEtaBins(nCells);
+  std::vector<double> exportEnergies(nCells);
+  std::vector<double> exportEtas(nCells);
+  std::vector<double> exportRecs(nCells);
+  std::vector<double> exportRecErrors(nCells);
+  std::vector<double> exportEdeps(nCells);
+  std::vector<double> exportEdepErrors(nCells);
+  std::vector<double> exportFsams(nCells);
+  std::vector<double> exportFsamErrors(nCells);
 
-  if (recFile == nullptr || recFile->IsOpen() == kFALSE) {
-    std::cerr << fmt::format("cannot open file {}\n", recPath);
-    return;
-  }
-  if (edepFile == nullptr || edepFile->IsOpen() == kFALSE) {
-    std::cerr << fmt::format("cannot open file {}\n", edepPath);
-    return;
-  }
   if (fsamFile == nullptr || fsamFile->IsOpen() == kFALSE) {
-    std::cerr << fmt::format("cannot open file {}\n", fsamPath);
-    return;
+    Logger::error("cannot open file {}", fsamPath);
+    delete fsamFile;
+    return summary;
+  }
+  TGraph2DErrors* graph = new TGraph2DErrors();
+
+  // rec and edep come from independent samples, so replica b of one can be
+  // paired with replica b of the other to get replicas of the ratio.
+  TTree* bootstrapTree = nullptr;
+  int treeEnergyBin;
+  int treeEtaBin;
+  BootstrapResult ratio;
+  if (hasBootstrap) {
+    bootstrapTree = new TTree("bootstrap_fsam", "bootstrap replicas of fsam");
+    bootstrapTree->Branch("energyBin", &treeEnergyBin);
+    bootstrapTree->Branch("etaBin", &treeEtaBin);
+    bootstrapTree->Branch("mean", &ratio.mean);
+    bootstrapTree->Branch("stdDev", &ratio.stdDev);
+    bootstrapTree->Branch("lower", &ratio.lower);
+    bootstrapTree->Branch("upper", &ratio.upper);
+    bootstrapTree->Branch("replicas", &ratio.replicas);
   }
 
   for (size_t i = 0; i < energyBins.size(); ++i) {
     std::string histName{fmt::format("E{}", energyBins[i])};
-    std::cout << "reading " << histName << '\n';
-
-    TH1D* recHist = recFile->Get<TH1D>(histName.c_str());
-    TH1D* edepHist = edepFile->Get<TH1D>(histName.c_str());
     TH1D* fsamHist = new TH1D(
       histName.c_str(),
       histName.c_str(),
       etaBins.size(),
       etaBins.getBinEdges());
     fsamEHists.push_back(fsamHist);
-    if (recHist == nullptr || edepHist == nullptr) {
-      std::cerr << "failed to read histogram\n";
-      return;
-    }
-    if (fsamHist == nullptr) {
-      std::cerr << "failed to allocate TH1D\n";
-      return;
-    }
+  }
+  for (size_t i = 0; i < etaBins.size(); ++i) {
+    std::string histName{fmt::format("eta{}", etaBins.getMiddleValue(i))};
+    TH1D* fsamHist = new TH1D(
+      histName.c_str(),
+      histName.c_str(),
+      energyBins.size(),
+      energyBins.getBinEdges());
+    fsamEtaHists.push_back(fsamHist);
+  }
+
+  summary.nCells = energyBins.size() * etaBins.size();
+  for (size_t i = 0; i < energyBins.size(); ++i) {
     for (size_t j = 0; j < etaBins.size(); ++j) {
-      double rec = recHist->GetBinContent(j + 1);
-      double recError = recHist->GetBinError(j + 1);
-      double edep = edepHist->GetBinContent(j + 1);
-      // double edepError = edepHist->GetBinError(j);
+      size_t cell = i * etaBins.size() + j;
+      double rec = recTable.value[cell];
+      double recError = recTable.error[cell];
+      double edep = edepTable.value[cell];
+      // double edepError = edepTable.error[cell];
       double fsam;
       double fsamError;
 
@@ -83,49 +208,42 @@ getFsam(std::string recPath, std::string edepPath)
         fsam = rec / edep;
         fsamError = recError / edep;
       }
-      fsamHist->SetBinContent(j + 1, fsam);
-      fsamHist->SetBinError(j + 1, fsamError);
-      graph->SetPoint(
-        i * etaBins.size() + j,
-        etaBins.getMiddleValue(j),
-        energyBins[i], fsam);
+      if (hasBootstrap) {
+        const auto& recReplicas = recTable.replicas[cell];
+        const auto& edepReplicas = edepTable.replicas[cell];
+        std::vector<double> ratioReplicas(
+          std::min(recReplicas.size(), edepReplicas.size()));
+        for (size_t b = 0; b < ratioReplicas.size(); ++b) {
+          ratioReplicas[b] = recReplicas[b] / edepReplicas[b];
+        }
+        ratio = Bootstrap::summarize(std::move(ratioReplicas));
+        treeEnergyBin = i;
+        treeEtaBin = j;
+        bootstrapTree->Fill();
+        // bootstrap spread includes the edep error dropped above.
+        if (fsam != 0. && ratio.stdDev > 0.) {
+          fsamError = ratio.stdDev;
+        }
+      }
+      fsamEHists[i]->SetBinContent(j + 1, fsam);
+      fsamEHists[i]->SetBinError(j + 1, fsamError);
+      tableValues[cell] = fsam;
+      tableValid[cell] = fsam > 0.;
+      exportEnergyBins[cell] = i;
+      exportEtaBins[cell] = j;
+      exportEnergies[cell] = energyBins[i];
+      exportEtas[cell] = etaBins.getMiddleValue(j);
+      exportRecs[cell] = rec;
+      exportRecErrors[cell] = recError;
+      exportEdeps[cell] = edep;
+      exportEdepErrors[cell] = edepTable.error[cell];
+      exportFsams[cell] = fsam;
+      exportFsamErrors[cell] = fsamError;
+      graph->SetPoint(cell, etaBins.getMiddleValue(j), energyBins[i], fsam);
       graph->SetPointError(
-        i * etaBins.size() + j,
-        etaBins.getMiddleValue(j),
-        energyBins[i], fsamError);
-    }
-    delete recHist;
-    delete edepHist;
-  }
-
-  for (size_t i = 0; i < etaBins.size(); ++i) {
-    std::string histName{fmt::format("eta{}", etaBins.getMiddleValue(i))};
-    std::cout << "reading " << histName << '\n';
-
-    TH1D* recHist = recFile->Get<TH1D>(histName.c_str());
-    TH1D* edepHist = edepFile->Get<TH1D>(histName.c_str());
-    TH1D* fsamHist = new TH1D(
-      histName.c_str(),
-      histName.c_str(),
-      energyBins.size(),
-      energyBins.getBinEdges());
-    fsamEtaHists.push_back(fsamHist);
-    if (recHist == nullptr || edepHist == nullptr) {
-      std::cerr << "failed to read histogram\n";
-      return;
-    }
-    if (fsamHist == nullptr) {
-      std::cerr << "failed to allocate TH1D\n";
-      return;
-    }
-    for (size_t j = 0; j < energyBins.size(); ++j) {
-      double rec = recHist->GetBinContent(j + 1);
-      double recError = recHist->GetBinError(j + 1);
-      double edep = edepHist->GetBinContent(j + 1);
-      // double edepError = edepHist->GetBinError(j);
-      double fsam;
-      double fsamError;
+        cell, etaBins.getMiddleValue(j), energyBins[i], fsamError);
 
+      // eta histograms keep their own rule for empty deposit.
       if (edep == 0.) {
         fsam = 0.;
         fsamError = recError;
@@ -133,14 +251,57 @@ getFsam(std::string recPath, std::string edepPath)
         fsam = rec / edep;
         fsamError = recError / edep;
       }
-      fsamHist->SetBinContent(j + 1, fsam);
-      fsamHist->SetBinError(j + 1, fsamError);
+      if (hasBootstrap && edep != 0. && ratio.stdDev > 0.) {
+        fsamError = ratio.stdDev;
+      }
+      fsamEtaHists[j]->SetBinContent(i + 1, fsam);
+      fsamEtaHists[j]->SetBinError(i + 1, fsamError);
+
+      if (fsam != 0.) {
+        summary.min = summary.nFilled == 0 ? fsam : std::min(summary.min, fsam);
+        summary.max = summary.nFilled == 0 ? fsam : std::max(summary.max, fsam);
+        summary.mean += fsam;
+        ++summary.nFilled;
+      }
     }
-    delete recHist;
-    delete edepHist;
   }
+  if (summary.nFilled > 0) {
+    summary.mean /= summary.nFilled;
+  }
+
   graph->SetTitle("Sampling fraction; Eta; Energy;");
   graph->SaveAs(fmt::format("{}fsam2Dgraph.root", resultPath).c_str());
+  delete graph;
+  std::vector<double> etaCenters(etaBins.size());
+  for (size_t j = 0; j < etaBins.size(); ++j) {
+    etaCenters[j] = etaBins.getMiddleValue(j);
+  }
+  if (FsamTable::write(
+        resultPath + "fsamTable.bin",
+        energyBins.getEnergyBins(),
+        etaCenters,
+        tableValues,
+        tableValid,
+        options.lutInterpolation,
+        options.lutExtrapolation,
+        options.lutSmooth)
+      == false) {
+    Logger::error("cannot write {}fsamTable.bin", resultPath);
+  }
+  if (options.exportFormat != ExportTable::kNone) {
+    ExportTable table("fsam.fsam", 1);
+    table.addColumn("energyBin", std::move(exportEnergyBins));
+    table.addColumn("etaBin", std::move(exportEtaBins));
+    table.addColumn("energy", std::move(exportEnergies));
+    table.addColumn("eta", std::move(exportEtas));
+    table.addColumn("rec", std::move(exportRecs));
+    table.addColumn("recError", std::move(exportRecErrors));
+    table.addColumn("edep", std::move(exportEdeps));
+    table.addColumn("edepError", std::move(exportEdepErrors));
+    table.addColumn("fsam", std::move(exportFsams));
+    table.addColumn("fsamError", std::move(exportFsamErrors));
+    table.write(resultPath + "fsam", options.exportFormat);
+  }
   fsamFile->cd();
   for (TH1D* hist : fsamEHists) {
     hist->Write();
@@ -148,5 +309,242 @@ getFsam(std::string recPath, std::string edepPath)
   for (TH1D* hist : fsamEtaHists) {
     hist->Write();
   }
+  if (bootstrapTree != nullptr) {
+    bootstrapTree->Write();
+  }
   fsamFile->Close();
+  delete fsamFile;
+  summary.isValid = true;
+  return summary;
+}
+
+// per layer and per radial bin sampling fraction of every cell from the
+// profiles.root files of HistManager --profiles. skipped if either is missing.
+static void
+writeProfileRatios(
+  const std::string& recPath,
+  const std::string& edepPath,
+  const std::string& resultPath,
+  const Energy& energyBins,
+  const Eta& etaBins)
+{
+  TFile* recFile = TFile::Open((recPath + "profiles.root").c_str(), "READ");
+  TFile* edepFile = TFile::Open((edepPath + "profiles.root").c_str(), "READ");
+
+  if (recFile == nullptr || edepFile == nullptr || recFile->IsOpen() == kFALSE
+      || edepFile->IsOpen() == kFALSE) {
+    delete recFile;
+    delete edepFile;
+    return;
+  }
+  std::string ratioPath = resultPath + "fsamProfiles.root";
+  TFile* ratioFile = TFile::Open(ratioPath.c_str(), "CREATE");
+  if (ratioFile == nullptr || ratioFile->IsOpen() == kFALSE) {
+    Logger::error("cannot open file {}", ratioPath);
+    delete recFile;
+    delete edepFile;
+    delete ratioFile;
+    return;
+  }
+  for (size_t i = 0; i < energyBins.size(); ++i) {
+    for (size_t j = 0; j < etaBins.size(); ++j) {
+      std::string simInfo = fmt::format(
+        "E{:.2f}_H{:.1f}t{:.1f}",
+        energyBins[i],
+        etaBins.getLowerBound(j),
+        etaBins.getUpperBound(j));
+      for (const char* kind : { "layer", "radial" }) {
+        std::string histName = fmt::format("{}_{}", kind, simInfo);
+        TH1D* recHist = recFile->Get<TH1D>(histName.c_str());
+        TH1D* edepHist = edepFile->Get<TH1D>(histName.c_str());
+        if (recHist != nullptr && edepHist != nullptr) {
+          ratioFile->cd();
+          TH1D* ratioHist = static_cast<TH1D*>(recHist->Clone(histName.c_str()));
+          ratioHist->Divide(edepHist);
+          ratioHist->GetYaxis()->SetTitle("Sampling fraction");
+          ratioHist->Write();
+          delete ratioHist;
+        }
+        delete recHist;
+        delete edepHist;
+      }
+    }
+  }
+  ratioFile->Close();
+  recFile->Close();
+  edepFile->Close();
+  delete ratioFile;
+  delete recFile;
+  delete edepFile;
+  Logger::info("profile ratios are written to {}", ratioPath);
+}
+
+static void
+appendSlash(std::string& path)
+{
+  if (path.empty() == false && path.back() != '/') {
+    path.push_back('/');
+  }
+}
+
+void
+getFsam(std::string recPath, std::string edepPath, const RunOptions& options)
+{
+  appendSlash(recPath);
+  appendSlash(edepPath);
+
+  Eta etaBins{recPath + "ETA_range"};
+  Energy energyBins{recPath + "E_range"};
+
+  CellTable recTable =
+    readCellTable(recPath + "1DHists.root", "recEnergy", energyBins, etaBins);
+  if (recTable.isValid == false) {
+    return;
+  }
+  CellTable edepTable =
+    readCellTable(edepPath + "1DHists.root", "simEnergy", energyBins, etaBins);
+  if (edepTable.isValid == false) {
+    return;
+  }
+  writeFsam(recTable, edepTable, energyBins, etaBins, edepPath, options);
+  writeProfileRatios(recPath, edepPath, edepPath, energyBins, etaBins);
+}
+
+/*
+ * manifest format: one pair per line, '#' starts a comment.
+ *   REC_PATH EDEP_PATH [OUTPUT_PATH]
+ * OUTPUT_PATH defaults to EDEP_PATH as in the single pair mode.
+ * every input 1DHists.root is opened once even if it appears in many pairs,
+ * and the pairs are processed concurrently by nWorkers threads.
+ * summary of all pairs is written to MANIFEST.summary.
+ * returns false if the manifest or the summary cannot be opened or any
+ * pair failed.
+ */
+bool
+getFsamBatch(const std::string& manifestPath, const RunOptions& options)
+{
+  const size_t nWorkers = options.nJobs;
+  struct Job
+  {
+    std::string recPath;
+    std::string edepPath;
+    std::string resultPath;
+    FsamSummary summary;
+  };
+  std::ifstream manifest(manifestPath);
+  std::vector<Job> jobs;
+  std::string line;
+
+  if (manifest.is_open() == false) {
+    Logger::error("cannot open manifest {}", manifestPath);
+    return false;
+  }
+  while (std::getline(manifest, line)) {
+    std::stringstream ss(line.substr(0, line.find('#')));
+    Job job;
+
+    if (!(ss >> job.recPath >> job.edepPath)) {
+      continue;
+    }
+    if (!(ss >> job.resultPath)) {
+      job.resultPath = job.edepPath;
+    }
+    appendSlash(job.recPath);
+    appendSlash(job.edepPath);
+    appendSlash(job.resultPath);
+    jobs.push_back(job);
+  }
+  Logger::info("{} pairs in {}", jobs.size(), manifestPath);
+
+  ROOT::EnableThreadSafety();
+
+  // the first job asking for a file reads it, the others wait on its future.
+  std::mutex cacheMutex;
+  std::map<std::string, std::shared_future<std::shared_ptr<CellTable>>> cache;
+  auto getTable = [&cacheMutex, &cache](
+                    const std::string& path,
+                    const std::string& columnName,
+                    const Energy& energyBins,
+                    const Eta& etaBins) {
+    std::promise<std::shared_ptr<CellTable>> promise;
+    std::shared_future<std::shared_ptr<CellTable>> future;
+    bool isReader = false;
+    {
+      std::lock_guard<std::mutex> lock(cacheMutex);
+      auto found = cache.find(path + columnName);
+      if (found == cache.end()) {
+        future = promise.get_future().share();
+        cache.emplace(path + columnName, future);
+        isReader = true;
+      } else {
+        future = found->second;
+      }
+    }
+    if (isReader) {
+      promise.set_value(std::make_shared<CellTable>(
+        readCellTable(path + "1DHists.root", columnName, energyBins, etaBins)));
+    }
+    return future.get();
+  };
+
+  std::vector<std::future<void>> futures;
+  {
+    ThreadPool pool(nWorkers == 0 ? ThreadPool::defaultSize() : nWorkers);
+
+    for (Job& job : jobs) {
+      futures.push_back(pool.submit([&job, &getTable, &options]() {
+        LogContext logContext(job.recPath, "pair");
+        Eta etaBins{job.recPath + "ETA_range"};
+        Energy energyBins{job.recPath + "E_range"};
+
+        auto recTable = getTable(job.recPath, "recEnergy", energyBins, etaBins);
+        auto edepTable =
+          getTable(job.edepPath, "simEnergy", energyBins, etaBins);
+        if (recTable->isValid == false || edepTable->isValid == false
+            || recTable->value.size() != edepTable->value.size()
+            || recTable->value.size() != energyBins.size() * etaBins.size()) {
+          Logger::error("skipping pair {} {}", job.recPath, job.edepPath);
+          return;
+        }
+        job.summary = writeFsam(
+          *recTable, *edepTable, energyBins, etaBins, job.resultPath, options);
+        writeProfileRatios(
+          job.recPath, job.edepPath, job.resultPath, energyBins, etaBins);
+      }));
+    }
+    for (auto& future : futures) {
+      future.get();
+    }
+  }
+
+  std::string summaryPath = manifestPath + ".summary";
+  std::ofstream summaryFile(summaryPath);
+  if (summaryFile.is_open() == false) {
+    Logger::error("cannot open file {}", summaryPath);
+    return false;
+  }
+  size_t nFailed = 0;
+  summaryFile << "# rec\tedep\toutput\tstatus\tcells\tfilled\tmean\tmin\tmax\n";
+  for (const Job& job : jobs) {
+    const FsamSummary& summary = job.summary;
+    summaryFile << fmt::format(
+      "{}\t{}\t{}\t{}\t{}\t{}\t{:.6f}\t{:.6f}\t{:.6f}\n",
+      job.recPath,
+      job.edepPath,
+      job.resultPath,
+      summary.isValid ? "ok" : "failed",
+      summary.nCells,
+      summary.nFilled,
+      summary.mean,
+      summary.min,
+      summary.max);
+    if (summary.isValid == false) {
+      ++nFailed;
+    }
+  }
+  Logger::info("summary is written to {}", summaryPath);
+  if (nFailed > 0) {
+    Logger::error("{} of {} pairs failed", nFailed, jobs.size());
+  }
+  return nFailed == 0;
 }
@@ -35,6 +35,11 @@ if [ -z "${PARTICLE}" ] ; then
   export PARTICLE="electron"
 fi
 
+# random, halton or stratified, see emcal_barrel_particles_gen_eta.cxx
+if [ -z "${SAMPLING}" ] ; then
+  export SAMPLING="random"
+fi
+
 export JUGGLER_GEN_FILE="${GEN_FILE}"
 export JUGGLER_SIM_FILE="${SIM_FILE}"
 export JUGGLER_REC_FILE="${REC_FILE}"
@@ -42,36 +47,36 @@ export JUGGLER_REC_FILE="${REC_FILE}"
 echo "JUGGLER_N_EVENTS = ${JUGGLER_N_EVENTS}"
 echo "DETECTOR = ${DETECTOR}"
 
-SIGNATURE="${TIME}_${JOB_NUMBER}"
-INPUT=benchmarks/barrel_ecal/scripts/emcal_barrel_particles_gen_eta_${SIGNATURE}
-INPUT_FILE="${INPUT}.cxx"
-READ=benchmarks/barrel_ecal/scripts/emcal_barrel_particles_reader_parallel_${SIGNATURE}
-READ_FILE="${READ}.cxx"
-
-cp benchmarks/barrel_ecal/scripts/emcal_barrel_particles_gen_eta.cxx ${INPUT_FILE} && sed -ibackup_${SIGNATURE} "s/emcal_barrel_particles_gen_eta/emcal_barrel_particles_gen_eta_${SIGNATURE}/" ${INPUT_FILE}
+SCRIPT_DIR=benchmarks/barrel_ecal/scripts
+GEN_EXE=${SCRIPT_DIR}/emcal_barrel_particles_gen_eta
+READ_EXE=${SCRIPT_DIR}/emcal_barrel_particles_reader_parallel
 
-cp benchmarks/barrel_ecal/scripts/emcal_barrel_particles_reader_parallel.cxx ${READ_FILE} && sed -ibackup_${SIGNATURE} "s/emcal_barrel_particles_reader_parallel/emcal_barrel_particles_reader_parallel_${SIGNATURE}/" ${READ_FILE}
+# the first job builds the executables under the lock; later jobs find them
+# up to date and start right away.
+flock ${SCRIPT_DIR}/.build.lock make -s -C ${SCRIPT_DIR}
+if [[ "$?" -ne "0" ]] ; then
+  echo "ERROR building generator and reader in ${SCRIPT_DIR}"
+  exit 1
+fi
 
 # Generate the input events
-root -b -q "${INPUT_FILE}+(${JUGGLER_N_EVENTS}, ${E_START}, ${E_END}, ${ETA_START}, ${ETA_END}, \"${PARTICLE}\")"
+${GEN_EXE} ${JUGGLER_N_EVENTS} ${E_START} ${E_END} ${ETA_START} ${ETA_END} "${PARTICLE}" \
+  ${SAMPLING} ${JOB_NUMBER:-0}
 if [[ "$?" -ne "0" ]] ; then
   echo "ERROR running script: generating input events"
-  rm -f ${INPUT}* ${READ}*
   exit 1
 fi
 echo "input is generated"
 
 # Plot the input events
-root -b -q "${READ_FILE}+(\"${PARTICLE}\")"
+${READ_EXE} "${PARTICLE}"
 if [[ "$?" -ne "0" ]] ; then
   echo "ERROR running script: plotting input events"
-  rm -f ${INPUT}* ${READ}*
   exit 1
 fi
 echo "input is readable"
 
 echo "simulation starts"
-rm -f ${INPUT_FILE}* ${READ_FILE}*
 
 ddsim --runType batch \
       -v WARNING \